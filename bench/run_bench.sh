@@ -0,0 +1,149 @@
+#!/bin/bash
+
+# Simulator throughput regression benchmark
+# Usage: ./bench/run_bench.sh [--update | --update-all]
+#   builds the benchmark configurations, runs every workload BENCH_RUNS times (default 3) and compares
+#   the median KIPS, peak RSS and a digest of the simulation statistics against bench/baseline.txt
+#   --update rewrites only the baseline rows whose statistics changed or that are new
+#   --update-all rewrites every row, e.g. for a new host or a change meant to speed the simulator up
+
+cd "$(dirname "$0")/.."
+
+N_WARM=100000
+N_SIM=500000
+N_TRACE=2000000
+BASELINE=bench/baseline.txt
+TRACE_DIR=bench/traces
+RESULT=bench/result.txt
+N_RUNS=${BENCH_RUNS:-3}
+
+UPDATE=0
+if [ "$1" == "--update" ]; then
+    UPDATE=1
+elif [ "$1" == "--update-all" ]; then
+    UPDATE=2
+fi
+
+# config name, build_champsim.sh arguments
+CONFIGS=(
+    "base bimodal no no no no lru 1"
+    "pref hashed_perceptron no no kpcp no ship 1"
+    "ucp bimodal no no no no lru 4"
+)
+
+# config name, workload name, traces (one per core)
+WORKLOADS=(
+    "base stream stream"
+    "base chase chase"
+    "base branchy branchy"
+    "pref stream stream"
+    "pref chase chase"
+    "pref branchy branchy"
+    "ucp mix4 stream chase branchy stream"
+)
+
+# optional real trace snippets, run on the single-core configurations when they are available
+for TRACE in $BENCH_REAL_TRACES; do
+    WORKLOADS+=("base $(basename $TRACE) $TRACE" "pref $(basename $TRACE) $TRACE")
+done
+
+# synthetic traces
+mkdir -p $TRACE_DIR bin
+g++ -O2 -o bin/synth_trace bench/synth_trace.cc || exit 1
+for KIND in stream chase branchy; do
+    if [ ! -f $TRACE_DIR/$KIND.champsimtrace.xz ]; then
+        echo "Generating $KIND trace"
+        bin/synth_trace $KIND $N_TRACE | xz -1 > $TRACE_DIR/$KIND.champsimtrace.xz
+    fi
+done
+
+# binaries
+for CONFIG in "${CONFIGS[@]}"; do
+    set -- $CONFIG
+    NAME=$1
+    shift
+    ./build_champsim.sh "$@" > /dev/null 2>&1 || { echo "[ERROR] cannot build config $NAME: $*"; exit 1; }
+    BINARY="${1}-${2}-${3}-${4}-${5}-${6}-${7}core"
+    mv bin/$BINARY bin/bench-$NAME
+done
+
+# peak RSS of the simulator (in KB) through getrusage
+run_measured() {
+    python3 -c '
+import resource, subprocess, sys
+subprocess.run(sys.argv[2:], stdout=open(sys.argv[1], "w"), stderr=subprocess.STDOUT)
+print(resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)' "$@"
+}
+
+STATUS=0
+printf "%-6s %-24s %10s %10s %8s %10s %10s %s\n" config workload KIPS base_KIPS delta RSS_KB base_RSS stats | tee $RESULT
+for WORKLOAD in "${WORKLOADS[@]}"; do
+    set -- $WORKLOAD
+    NAME=$1
+    WL=$2
+    shift 2
+
+    TRACES=""
+    for T in "$@"; do
+        if [ -f "$T" ]; then
+            TRACES="$TRACES $T"
+        else
+            TRACES="$TRACES $TRACE_DIR/$T.champsimtrace.xz"
+        fi
+    done
+
+    # the median of several runs, a single run is at the mercy of the host
+    LOG=bench/$NAME-$WL.log
+    NUM_CORES=$#
+    ALL_KIPS=""
+    for RUN in $(seq $N_RUNS); do
+        BEGIN=$(date +%s.%N)
+        RSS=$(run_measured $LOG bin/bench-$NAME -warmup_instructions $N_WARM -simulation_instructions $N_SIM -hide_heartbeat -traces $TRACES)
+        END=$(date +%s.%N)
+        ALL_KIPS="$ALL_KIPS $(echo "$BEGIN $END $NUM_CORES" | awk -v n=$((N_WARM + N_SIM)) '{ printf "%.1f", n * $3 / ($2 - $1) / 1000 }')"
+    done
+    KIPS=$(echo $ALL_KIPS | tr ' ' '\n' | sort -n | awk '{ v[NR] = $1 } END { print v[int((NR + 1) / 2)] }')
+
+    # statistics must not depend on host speed, drop the wall-clock times
+    DIGEST=$(sed -e 's/(Simulation time:.*)//' -e '/^Simulator Profile/,$d' $LOG | md5sum | cut -c1-12)
+
+    BASE=$(grep "^$NAME $WL " $BASELINE 2>/dev/null)
+    BASE_KIPS=$(echo $BASE | cut -d' ' -f3)
+    BASE_RSS=$(echo $BASE | cut -d' ' -f4)
+    BASE_DIGEST=$(echo $BASE | cut -d' ' -f5)
+
+    DELTA="-"
+    if [ -n "$BASE_KIPS" ]; then
+        DELTA=$(awk -v a=$KIPS -v b=$BASE_KIPS 'BEGIN { printf "%+.1f%%", 100 * (a - b) / b }')
+    fi
+
+    STATS="new"
+    if [ -n "$BASE_DIGEST" ]; then
+        if [ "$DIGEST" == "$BASE_DIGEST" ]; then
+            STATS="same"
+        else
+            STATS="CHANGED"
+            STATUS=1
+        fi
+    fi
+
+    printf "%-6s %-24s %10s %10s %8s %10s %10s %s\n" $NAME $WL $KIPS "${BASE_KIPS:--}" $DELTA $RSS "${BASE_RSS:--}" $STATS | tee -a $RESULT
+    if [ $UPDATE -eq 1 ] && [ "$STATS" == "same" ]; then
+        echo "$BASE" >> $RESULT.new
+    else
+        echo "$NAME $WL $KIPS $RSS $DIGEST" >> $RESULT.new
+    fi
+done
+
+if [ $UPDATE -ne 0 ]; then
+    mv $RESULT.new $BASELINE
+    echo "Baseline updated: $BASELINE"
+    STATUS=0
+else
+    rm -f $RESULT.new
+fi
+
+if [ $STATUS -ne 0 ]; then
+    echo "[ERROR] simulation statistics differ from the baseline"
+fi
+exit $STATUS
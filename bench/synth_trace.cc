@@ -0,0 +1,112 @@
+// Synthetic ChampSim trace generator for the throughput benchmarks
+// usage: synth_trace [stream|chase|branchy] [num_instr] | xz > name.champsimtrace.xz
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+
+#define NUM_INSTR_DESTINATIONS 2
+#define NUM_INSTR_SOURCES 4
+
+// special registers that ChampSim uses to identify branches
+#define REG_STACK_POINTER 6
+#define REG_FLAGS 25
+#define REG_INSTRUCTION_POINTER 26
+
+typedef struct trace_instr_format {
+    unsigned long long int ip;  // instruction pointer (program counter) value
+
+    unsigned char is_branch;    // is this branch
+    unsigned char branch_taken; // if so, is this taken
+
+    unsigned char destination_registers[NUM_INSTR_DESTINATIONS]; // output registers
+    unsigned char source_registers[NUM_INSTR_SOURCES];           // input registers
+
+    unsigned long long int destination_memory[NUM_INSTR_DESTINATIONS]; // output memory
+    unsigned long long int source_memory[NUM_INSTR_SOURCES];           // input memory
+} trace_instr_format_t;
+
+#define LOOP_BODY 64                 // instructions per loop iteration
+#define FOOTPRINT (1ULL << 28)       // 256MB streaming footprint
+#define CHASE_FOOTPRINT (1ULL << 24) // 16MB pointer chasing footprint, larger than the 4-core LLC
+#define DATA_BASE 0x10000000ULL
+#define CODE_BASE 0x400000ULL
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s [stream|chase|branchy] [num_instr]\n", argv[0]);
+        return 1;
+    }
+
+    const char *kind = argv[1];
+    unsigned long long num_instr = strtoull(argv[2], NULL, 10);
+    if (strcmp(kind, "stream") && strcmp(kind, "chase") && strcmp(kind, "branchy")) {
+        fprintf(stderr, "unknown trace kind: %s\n", kind);
+        return 1;
+    }
+
+    // fixed seed so that every run generates the same trace
+    std::mt19937_64 engine(0xC0FFEE);
+    unsigned long long stream_addr = DATA_BASE, chase_addr = DATA_BASE;
+
+    trace_instr_format_t instr;
+    for (unsigned long long n = 0; n < num_instr; n++) {
+        memset(&instr, 0, sizeof(instr));
+
+        uint32_t slot = n % LOOP_BODY;
+        instr.ip = CODE_BASE + slot * 4;
+
+        if (slot == LOOP_BODY - 1) {
+            // loop back-edge
+            instr.is_branch = 1;
+            instr.branch_taken = 1;
+            instr.destination_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[1] = REG_FLAGS;
+        }
+        else if (!strcmp(kind, "branchy") && (slot % 4 == 3)) {
+            // data-dependent conditional branches, half of them are unpredictable
+            instr.is_branch = 1;
+            instr.branch_taken = (slot % 8 == 3) ? (engine() & 1) : ((n / LOOP_BODY) % 3 == 0);
+            instr.destination_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[0] = REG_INSTRUCTION_POINTER;
+            instr.source_registers[1] = REG_FLAGS;
+        }
+        else if (slot % 4 == 1) {
+            if (!strcmp(kind, "stream")) {
+                // two sequential streams, one read and one written
+                stream_addr = DATA_BASE + ((stream_addr - DATA_BASE + 8) % FOOTPRINT);
+                instr.destination_registers[0] = 1 + (slot % 8);
+                instr.source_memory[0] = stream_addr;
+                if (slot % 8 == 5)
+                    instr.destination_memory[0] = stream_addr + FOOTPRINT;
+            }
+            else if (!strcmp(kind, "chase")) {
+                // every load depends on the previous one
+                chase_addr = DATA_BASE + ((engine() % CHASE_FOOTPRINT) & ~63ULL);
+                instr.destination_registers[0] = 1;
+                instr.source_registers[0] = 1;
+                instr.source_memory[0] = chase_addr;
+            }
+            else {
+                // small hot working set
+                instr.destination_registers[0] = 1 + (slot % 8);
+                instr.source_registers[0] = REG_STACK_POINTER;
+                instr.source_memory[0] = DATA_BASE + ((engine() % (1ULL << 15)) & ~7ULL);
+            }
+        }
+        else {
+            // alu operation
+            instr.destination_registers[0] = 10 + (slot % 6);
+            instr.source_registers[0] = 10 + ((slot + 1) % 6);
+            instr.source_registers[1] = 1 + (slot % 8);
+            instr.destination_registers[1] = REG_FLAGS;
+        }
+
+        fwrite(&instr, sizeof(instr), 1, stdout);
+    }
+
+    return 0;
+}
@@ -29,6 +29,8 @@ class BLOCK {
     // replacement state
     uint32_t lru;
 
+    uint64_t fill_cycle;
+
     BLOCK() {
         valid = 0;
         prefetch = 0;
@@ -48,6 +50,8 @@ class BLOCK {
         instr_id = 0;
 
         lru = 0;
+
+        fill_cycle = 0;
     };
 };
 
@@ -73,7 +77,9 @@ class PACKET {
             translated,
             fetched,
             prefetched,
-            drc_tag_read;
+            drc_tag_read,
+            is_metadata, // prefetcher metadata read or write, no cache is filled with it
+            clean_victim; // unmodified L2C victim written into an exclusive LLC, it does not make the line dirty
 
     int fill_level, 
         pf_origin_level,
@@ -113,7 +119,8 @@ class PACKET {
              instr_id,
              ip, 
              event_cycle,
-             cycle_enqueued;
+             cycle_enqueued,
+             dram_interference; // cycles a DRAM read waited on the requests of other cores
 
     PACKET() {
         instruction = 0;
@@ -126,6 +133,8 @@ class PACKET {
         fetched = 0;
         prefetched = 0;
         drc_tag_read = 0;
+        is_metadata = 0;
+        clean_victim = 0;
 
         returned = 0;
         asid[0] = UINT8_MAX;
@@ -166,6 +175,7 @@ class PACKET {
         ip = 0;
         event_cycle = UINT64_MAX;
 	cycle_enqueued = 0;
+        dram_interference = 0;
     };
 };
 
@@ -78,6 +78,67 @@ extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 #define LLC_MSHR_SIZE NUM_CPUS * 64
 #define LLC_LATENCY 20 // 4/5 (L1I or L1D) + 10 + 20 = 34/35 cycles
 
+// prefetch timeliness histograms
+#define PF_DISTANCE_BUCKETS 12 // powers of two of cycles, from <16 to >=16384
+#define PF_DEPTH_BUCKETS 16    // lookahead depth of the prefetch, the last bucket collects deeper prefetches
+#define PF_CONF_BUCKETS 10     // confidence of the prefetch, in steps of 10%
+
+// how the UCP ATD accounts for LLC prefetches (-ucp_prefetch)
+#define UCP_PF_IGNORE 0   // prefetches bypass the ATD, only demand reuse is measured
+#define UCP_PF_SEPARATE 1 // prefetch fills are modelled, demand hits on prefetched lines count as utility
+#define UCP_PF_DEMAND 2   // prefetch fills are modelled, only reuse of demand fetched lines counts as utility
+#define UCP_PF_CHARGE 3   // as UCP_PF_SEPARATE, minus a charge for the prefetches that were evicted unused
+
+// what the UCP lookahead allocator maximizes (-ucp_objective)
+#define UCP_OBJ_HITS 0             // total hit reduction in the ATD, every core weighs the same
+#define UCP_OBJ_WEIGHTED_SPEEDUP 1 // sum of the IPC of every core over its alone IPC
+#define UCP_OBJ_MAX_SLOWDOWN 2     // ways go to the core with the largest slowdown first
+#define UCP_MLP 2                  // LLC misses a core overlaps on average, used by the IPC model
+#define UCP_MISS_PENALTY 200       // cycles per LLC miss until a miss latency has been measured
+
+// how the LLC is partitioned (-llc_partition), page coloring gives every core the sets of its colors with all their ways,
+// line partitioning lets every core use every way and futility scaling holds each core at a target number of lines
+#define LLC_PART_WAYS 0
+#define LLC_PART_COLORS 1
+#define LLC_PART_LINES 2
+#define LOG2_COLOR_SETS (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE) // the set index bits above the page offset are the color of a page
+#define LLC_COLORS ((LLC_SET) >> LOG2_COLOR_SETS)
+// inclusion of the L2C and L1 caches in the LLC (-llc_inclusion)
+#define LLC_NON_INCLUSIVE 0
+#define LLC_INCLUSIVE 1 // an LLC victim is invalidated in the upper levels of every core
+#define LLC_EXCLUSIVE 2 // lines for the upper levels pass the LLC by, every L2C victim is written into it
+// what writeback_victim() sends to the lower level
+#define VICTIM_CLEAN 1 // a clean L2C victim for an exclusive LLC
+#define VICTIM_DIRTY 2 // dirty data, of the victim itself or of a copy in the upper levels
+#define LLC_LINE_UNITS ((LLC_WAY) * 8) // line targets are handed out in eighths of a way
+#define LLC_FS_INTERVAL 1024           // LLC fills between two adjustments of the futility scaling factors
+#define LLC_FS_STEP 1.1                // factor a scaling factor moves by per adjustment
+#define LLC_FS_MAX 256.0               // scaling factors stay within [1 / LLC_FS_MAX, LLC_FS_MAX]
+
+// quotient filter of the lines a cache recently prefetched or holds, modeled after PREFETCH_FILTER in spp_dev.h,
+// prefetch_line drops a target that hits in it before a PACKET is built (-pf_dedup 1 turns it on). It is cleared
+// after as many insertions as it has slots, so a dropped prefetch or one that never filled does not stay filtered
+#define PF_DEDUP_REMAINDER_BIT 7
+class PF_DEDUP_FILTER
+{
+public:
+    uint32_t quotient_bit,
+        inserts;                   // insertions since the last clear
+    vector<uint8_t> remainder_tag; // remainder with the top bit set, 0 is an empty slot
+
+    PF_DEDUP_FILTER()
+    {
+        quotient_bit = 0;
+        inserts = 0;
+    };
+
+    void init(uint32_t num_lines),
+        insert(uint64_t line),
+        erase(uint64_t line);
+    bool check(uint64_t line);
+    uint64_t hash(uint64_t line);
+};
+
 class CACHE : public MEMORY
 {
 public:
@@ -88,7 +149,29 @@ public:
     BLOCK **block;
     BLOCK ***atd;
     vector<int> partitions;
-    vector<vector<uint64_t>> hit_counts;
+    vector<pair<uint64_t, vector<uint32_t>>> partition_history; // (cycle, allocations) of every partitioning epoch
+    vector<vector<uint64_t>> hit_counts,
+        pf_hit_counts;              // ATD hits of demand requests on prefetched lines, per LRU position
+    vector<uint64_t> pf_useless_atd; // prefetched lines evicted unused from the ATD
+    vector<uint64_t> atd_access;     // ATD lookups that count a hit in hit_counts, decayed with them
+    vector<uint64_t> metadata_returned; // prefetcher metadata reads returned by DRAM, drained by the prefetcher
+    // per-core IPC model of the partitioning objectives, the instructions and cycles of the last epoch
+    vector<uint64_t> ucp_last_instr, ucp_last_cycle, ucp_last_interference, ucp_last_reads;
+    vector<double> ucp_epoch_instr, ucp_epoch_cycle, ucp_epoch_reads,
+        ucp_epoch_interference, // DRAM cycles the reads of the core waited on other cores
+        ucp_epoch_alone_cycle,  // cycles the model expects of the epoch with the whole LLC and DRAM to the core
+        ucp_alone_instr, ucp_alone_cycle; // sums of the epochs of the region of interest
+    double ucp_miss_penalty, ucp_hit_weight;
+    uint64_t ucp_last_latency, ucp_last_miss;
+    vector<uint32_t> color_owner,        // core that owns every page color, empty when partitioning by ways
+        color_first, color_count;        // range of colors of every core
+    vector<uint64_t> color_next;         // round robin over the colors of every core for new pages
+    uint64_t recolored;                  // colors that changed owner
+    vector<uint64_t> target_lines,       // lines every core is held at with line partitioning
+        owned_lines;                     // lines every core holds, recounted every epoch
+    vector<double> futility_scale;       // futility scaling factor of every core
+    uint64_t futility_fills;
+    uint8_t pseudo_partition;            // set by a replacement policy that shares every way and inserts by the allocations (PIPP)
     int fill_level;
     uint32_t MAX_READ, MAX_FILL;
     uint32_t reads_available_this_cycle;
@@ -99,7 +182,18 @@ public:
         pf_issued,
         pf_useful,
         pf_useless,
-        pf_fill;
+        pf_fill,
+        pf_late,      // demand requests that merged with an in-flight prefetch
+        pf_filtered;  // prefetches dropped by pf_filter
+    PF_DEDUP_FILTER pf_filter;
+
+    // prefetch timeliness, depth and confidence come from the prefetcher metadata carried on the PACKET and BLOCK
+    uint64_t pf_use_distance[PF_DISTANCE_BUCKETS],  // cycles from the prefetch fill to its first demand use
+        pf_late_distance[PF_DISTANCE_BUCKETS],      // cycles a prefetch had been in flight when a demand merged with it
+        pf_useful_depth[PF_DEPTH_BUCKETS],
+        pf_useless_depth[PF_DEPTH_BUCKETS],         // prefetched lines evicted before their first use
+        pf_useful_conf[PF_CONF_BUCKETS],
+        pf_useless_conf[PF_CONF_BUCKETS];
 
     // queues
     PACKET_QUEUE WQ{NAME + "_WQ", WQ_SIZE},       // write queue
@@ -115,6 +209,12 @@ public:
         roi_hit[NUM_CPUS][NUM_TYPES],
         roi_miss[NUM_CPUS][NUM_TYPES];
 
+    // inclusion traffic of the LLC, per core
+    uint64_t back_invalidations[NUM_CPUS], // upper level lines an inclusive LLC invalidated
+        back_invalidation_writebacks[NUM_CPUS], // dirty ones, their data leaves with the LLC victim
+        clean_victims[NUM_CPUS],               // clean L2C victims written into an exclusive LLC
+        moved_up[NUM_CPUS];                    // lines an exclusive LLC handed to the L2C on a hit
+
     uint64_t total_miss_latency;
 
     // constructor
@@ -185,13 +285,29 @@ public:
 
             // Hit counters is created for each way in an ATD, initalized with 0 hits
             hit_counts.resize(NUM_CPUS);
+            pf_hit_counts.resize(NUM_CPUS);
             for (uint32_t i = 0; i < NUM_CPUS; i++)
             {
                 for (uint32_t j = 0; j < NUM_WAY; j++)
                 {
                     hit_counts[i].push_back(0);
+                    pf_hit_counts[i].push_back(0);
                 }
             }
+            pf_useless_atd.resize(NUM_CPUS, 0);
+            atd_access.resize(NUM_CPUS, 0);
+
+            ucp_last_instr.resize(NUM_CPUS, 0);
+            ucp_last_cycle.resize(NUM_CPUS, 0);
+            ucp_last_interference.resize(NUM_CPUS, 0);
+            ucp_last_reads.resize(NUM_CPUS, 0);
+            ucp_epoch_reads.resize(NUM_CPUS, 0);
+            ucp_epoch_instr.resize(NUM_CPUS, 0);
+            ucp_epoch_cycle.resize(NUM_CPUS, 0);
+            ucp_epoch_interference.resize(NUM_CPUS, 0);
+            ucp_epoch_alone_cycle.resize(NUM_CPUS, 0);
+            ucp_alone_instr.resize(NUM_CPUS, 0);
+            ucp_alone_cycle.resize(NUM_CPUS, 0);
         }
 
         for (uint32_t i = 0; i < NUM_CPUS; i++)
@@ -208,9 +324,20 @@ public:
                 roi_hit[i][j] = 0;
                 roi_miss[i][j] = 0;
             }
+            back_invalidations[i] = 0;
+            back_invalidation_writebacks[i] = 0;
+            clean_victims[i] = 0;
+            moved_up[i] = 0;
         }
 
         total_miss_latency = 0;
+        ucp_miss_penalty = UCP_MISS_PENALTY;
+        ucp_hit_weight = 0;
+        ucp_last_latency = 0;
+        ucp_last_miss = 0;
+        recolored = 0;
+        futility_fills = 0;
+        pseudo_partition = 0;
 
         lower_level = NULL;
         extra_interface = NULL;
@@ -223,6 +350,10 @@ public:
         pf_useful = 0;
         pf_useless = 0;
         pf_fill = 0;
+        pf_late = 0;
+        pf_filtered = 0;
+        pf_filter.init(NUM_SET * NUM_WAY);
+        reset_pf_timeliness();
     };
 
     // destructor
@@ -239,7 +370,12 @@ public:
         add_pq(PACKET *packet);
 
     void return_data(PACKET *packet),
+        return_metadata(PACKET *packet),
         operate(),
+        reset_pf_timeliness(),
+        record_pf_use(BLOCK *b, uint64_t cycle),
+        record_pf_useless(BLOCK *b),
+        trace_llc(PACKET *packet, uint8_t event, uint8_t hit),
         increment_WQ_FULL(uint64_t address);
 
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
@@ -247,10 +383,13 @@ public:
 
     int check_hit(PACKET *packet),
         check_hit_atd(PACKET *packet),
+        llc_pf_cap_victim(uint32_t cpu, uint32_t set),
         invalidate_entry(uint64_t inval_addr),
         check_mshr(PACKET *packet),
         prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, uint32_t prefetch_metadata),
-        kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata);
+        kpc_prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata);
+
+    bool pf_dedup(uint64_t pf_addr, int pf_fill_level);
 
     void handle_fill(),
         handle_writeback(),
@@ -297,9 +436,35 @@ public:
         lru_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
         llc_lru_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
 
-    vector<uint32_t> partition_algorithm();
+    vector<uint32_t> partition_algorithm(),
+        fine_partition_algorithm(uint32_t units),
+        retarget_lines(const vector<uint32_t> &units);
+    void ucp_update_model(),
+        ucp_bandwidth_partition(const vector<uint32_t> &allocations),
+        ucp_decay_counters(),
+        color_initialize(),
+        recolor(const vector<uint32_t> &colors),
+        futility_initialize(),
+        futility_update(),
+        futility_fill(uint32_t cpu, uint32_t set, uint32_t way),
+        exclusive_move_up(uint32_t set, uint32_t way, uint32_t cpu);
+    uint8_t writeback_victim(uint32_t set, uint32_t way),
+        upper_dirty(uint64_t address),
+        back_invalidate(uint64_t address);
+    uint32_t llc_owner(uint32_t set, uint32_t cpu),
+        llc_futility_victim(uint32_t cpu, uint32_t set);
+    int atd_set(uint64_t address);
+    uint64_t color_page(uint32_t cpu, uint64_t ppage);
+    double ucp_fractional_hits(uint32_t core, double ways);
+    double ucp_extra_misses(uint32_t core, uint32_t ways),
+        ucp_cycles(uint32_t core, uint32_t ways),
+        ucp_utility(uint32_t core, uint32_t ways),
+        ucp_alone_ipc(uint32_t core),
+        ucp_epoch_alone_ipc(uint32_t core),
+        ucp_epoch_slowdown(uint32_t core);
     pair<float, uint32_t> get_max_mu(uint32_t core, uint32_t alloc, uint32_t balance);
     float get_mu_value(uint32_t core, uint32_t a, uint32_t b);
+    uint64_t ucp_hits(uint32_t core, uint32_t position);
 };
 
 #endif
@@ -25,6 +25,7 @@
 #define LLC_BYPASS
 #define DRC_BYPASS
 #define NO_CRC2_COMPILE
+//#define PROFILE_STAGES // rdtsc timers around every pipeline stage and operate(), see profiler.h
 
 #ifdef DEBUG_PRINT
 #define DP(x) x
@@ -79,7 +80,17 @@ extern uint8_t warmup_complete[NUM_CPUS],
                all_simulation_complete,
                MAX_INSTR_DESTINATIONS,
                knob_cloudsuite,
-               knob_low_bandwidth;
+               knob_low_bandwidth,
+               functional_warming,
+               knob_ucp_prefetch,
+               knob_ucp_pf_ways,
+               knob_ucp_objective,
+               knob_pf_dedup,
+               knob_dram_sched,
+               knob_llc_partition,
+               knob_llc_inclusion;
+
+extern double knob_ucp_min_ipc[NUM_CPUS];
 
 extern uint64_t current_core_cycle[NUM_CPUS], 
                 stall_cycle[NUM_CPUS], 
@@ -21,6 +21,13 @@ extern uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME;
 #define DRAM_WRITE_LOW_WM     ((DRAM_WQ_SIZE*3)>>2) // 6/8th
 #define MIN_DRAM_WRITES_PER_SWITCH (DRAM_WQ_SIZE*1/4)
 
+// read scheduling (-dram_sched), writes are always drained FR-FCFS
+#define DRAM_SCHED_FRFCFS 0    // oldest row buffer hit first, then the oldest read
+#define DRAM_SCHED_ATLAS 1     // reads of the core with the least attained bank service first, FR-FCFS among them
+#define DRAM_SCHED_PARTITION 2 // as ATLAS, with the service of every core scaled by the bandwidth share the LLC partitioner gives it
+#define DRAM_SERVICE_DECAY 0.875       // weight of the service attained in past epochs
+#define DRAM_STARVATION_CYCLES 100000  // a read waiting longer goes first whatever the rank of its core
+
 // DRAM
 class MEMORY_CONTROLLER : public MEMORY {
   public:
@@ -35,6 +42,16 @@ class MEMORY_CONTROLLER : public MEMORY {
 
     BANK_REQUEST bank_request[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
 
+    // interference accounting, the row every core would find open in a bank if it ran alone,
+    // the core that last used the data bus and the reads of every core with the cycles other cores cost them
+    uint32_t shadow_row[NUM_CPUS][DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS],
+             dbus_last_cpu[DRAM_CHANNELS];
+    uint64_t core_reads[NUM_CPUS], core_interference[NUM_CPUS], core_row_conflicts[NUM_CPUS];
+
+    // bank cycles every core attained in past epochs (decayed) and in the current one, and its share of the bandwidth
+    double attained_service[NUM_CPUS], bandwidth_share[NUM_CPUS];
+    uint64_t epoch_service[NUM_CPUS];
+
     // queues
     PACKET_QUEUE WQ[DRAM_CHANNELS], RQ[DRAM_CHANNELS];
 
@@ -53,10 +70,14 @@ class MEMORY_CONTROLLER : public MEMORY {
             write_mode[i] = 0;
             scheduled_reads[i] = 0;
             scheduled_writes[i] = 0;
+            dbus_last_cpu[i] = NUM_CPUS;
 
             for (uint32_t j=0; j<DRAM_RANKS; j++) {
-                for (uint32_t k=0; k<DRAM_BANKS; k++)
+                for (uint32_t k=0; k<DRAM_BANKS; k++) {
                     bank_cycle_available[i][j][k] = 0;
+                    for (uint32_t c=0; c<NUM_CPUS; c++)
+                        shadow_row[c][i][j][k] = UINT32_MAX;
+                }
             }
 
             WQ[i].NAME = "DRAM_WQ" + to_string(i);
@@ -68,6 +89,15 @@ class MEMORY_CONTROLLER : public MEMORY {
             RQ[i].entry = new PACKET [DRAM_RQ_SIZE];
         }
 
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            core_reads[i] = 0;
+            core_interference[i] = 0;
+            core_row_conflicts[i] = 0;
+            attained_service[i] = 0;
+            bandwidth_share[i] = 1.0 / NUM_CPUS;
+            epoch_service[i] = 0;
+        }
+
         fill_level = FILL_DRAM;
     };
 
@@ -91,7 +121,10 @@ class MEMORY_CONTROLLER : public MEMORY {
     void schedule(PACKET_QUEUE *queue), process(PACKET_QUEUE *queue),
          update_schedule_cycle(PACKET_QUEUE *queue),
          update_process_cycle(PACKET_QUEUE *queue),
-         reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel);
+         reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel),
+         new_service_epoch(const double *share);
+
+    int rank_schedule(PACKET_QUEUE *queue, uint8_t &row_buffer_hit);
 
     uint32_t dram_get_channel(uint64_t address),
              dram_get_rank   (uint64_t address),
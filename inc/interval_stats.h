@@ -0,0 +1,63 @@
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include "cache.h"
+#include "dram_controller.h"
+
+// one snapshot, event counters are deltas since the previous snapshot,
+// ways, hit_counts and queue occupancies are the values at the time of the snapshot,
+// alone_ipc and slowdown the estimates of the last UCP epoch
+class INTERVAL_SAMPLE {
+  public:
+    uint64_t cycle,
+             instr[NUM_CPUS],
+             cycles[NUM_CPUS],
+             l1d_miss[NUM_CPUS],
+             l2c_miss[NUM_CPUS],
+             llc_miss[NUM_CPUS],
+             dram_reads[NUM_CPUS],
+             dram_interference[NUM_CPUS],
+             hit_counts[NUM_CPUS][LLC_WAY],
+             row_buffer_hit,
+             row_buffer_miss;
+    uint32_t ways[NUM_CPUS],
+             rq_occupancy[DRAM_CHANNELS],
+             wq_occupancy[DRAM_CHANNELS];
+    double alone_ipc[NUM_CPUS],
+           slowdown[NUM_CPUS];
+};
+
+// snapshots selected counters every PERIOD cycles into a preallocated ring buffer
+// and writes it out as CSV whenever the buffer fills up and at exit
+class INTERVAL_STATS {
+  public:
+    uint64_t PERIOD, next_cycle;
+    uint32_t SIZE, occupancy;
+    INTERVAL_SAMPLE *ring;
+    FILE *out;
+
+    // raw counters of the previous snapshot
+    uint64_t last_instr[NUM_CPUS], last_cycle[NUM_CPUS],
+             last_l1d_miss[NUM_CPUS], last_l2c_miss[NUM_CPUS], last_llc_miss[NUM_CPUS],
+             last_dram_reads[NUM_CPUS], last_dram_interference[NUM_CPUS],
+             last_row_buffer_hit, last_row_buffer_miss;
+
+    INTERVAL_STATS() {
+        PERIOD = 0;
+        next_cycle = 0;
+        SIZE = 0;
+        occupancy = 0;
+        ring = NULL;
+        out = NULL;
+    };
+
+    void initialize(uint64_t period, uint32_t size, const char *filename),
+         sample(),
+         snapshot(),
+         flush(),
+         finish();
+};
+
+extern INTERVAL_STATS interval_stats;
+
+#endif
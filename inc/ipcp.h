@@ -0,0 +1,29 @@
+#ifndef IPCP_H
+#define IPCP_H
+
+// IPCP classes, shared by the L1D and L2C parts of the prefetcher
+#define IPCP_NL 0      // no class, next line on a miss
+#define IPCP_CS 1      // constant stride
+#define IPCP_CPLX 2    // complex stride
+#define IPCP_GS 3      // global stream
+#define IPCP_NUM_CLASSES 4
+
+// the L1D prefetches carry their class and stride (the direction for a stream) to the L2C in pf_metadata,
+// bits 0-1 are the class and bits 2-8 the signed stride
+inline uint32_t ipcp_encode(uint8_t cls, int stride)
+{
+    return cls | ((stride & 0x7F) << 2);
+}
+
+inline uint8_t ipcp_class(uint32_t metadata)
+{
+    return metadata & 0x3;
+}
+
+inline int ipcp_stride(uint32_t metadata)
+{
+    int stride = (metadata >> 2) & 0x7F;
+    return (stride & 0x40) ? (stride - 0x80) : stride;
+}
+
+#endif
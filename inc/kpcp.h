@@ -2,6 +2,7 @@
 #define KPCP_H
 
 #include "cache.h"
+#include <bitset>
 
 // L2 SPP
 //#define L2_PF_DEBUG_PRINT
@@ -11,9 +12,9 @@
 #define L2_PF_DEBUG(x)
 #endif
 
-#define L2_ST_SET 1
-#define L2_ST_WAY 256
-#define L2_ST_PRIME 1
+// set-associative signature table indexed by a page hash
+#define L2_ST_SET 16
+#define L2_ST_WAY 16
 #define L2_PT_SET 512
 #define L2_PT_WAY 4
 #define L2_PT_PRIME 509
@@ -35,13 +36,15 @@ class SIGNATURE_TABLE {
         last_block,
         signature,
         lru,
-        l2_pf[64],
-        used[64],
-        delta[64],
-        depth[64],
-        dirty[64],
         first_hit;
 
+    // per-block state of the page, packed to keep a table entry within a few cache lines
+    bitset<64> l2_pf,
+               used,
+               dirty;
+    int8_t delta[64];
+    uint8_t depth[64];
+
     SIGNATURE_TABLE() {
         valid = 0;
         tag = 0;
@@ -50,11 +53,8 @@ class SIGNATURE_TABLE {
         lru = 0;
         
         for (uint32_t i=0; i<64; i++) {
-            l2_pf[i] = 0;
-            used[i] = 0;
             delta[i] = 0;
             depth[i] = 0;
-            dirty[i] = 0;
         }
 
         first_hit = 0;
@@ -98,6 +98,7 @@ extern int L2_PT_access[NUM_CPUS], L2_PT_hit[NUM_CPUS], L2_PT_invalid[NUM_CPUS],
 extern int l2_sig_dist[NUM_CPUS][1<<SIG_LENGTH];
 
 unsigned int get_new_signature(unsigned int old_signature, int curr_delta);
+uint32_t L2_ST_get_set(uint64_t page);
 int L2_ST_update(uint32_t cpu, uint64_t addr);
 int L2_ST_check(uint32_t cpu, uint64_t addr);
 void L2_PT_update(uint32_t cpu, int signature, int delta);
@@ -135,13 +136,21 @@ unsigned int get_new_signature(unsigned int old_signature, int curr_delta)
     return new_signature;
 }
 
+// Hash the page number into a signature table set
+uint32_t L2_ST_get_set(uint64_t page)
+{
+    page ^= (page >> 17);
+    page *= 2654435761; // Knuth's multiplicative hash
+    return (page >> 16) % L2_ST_SET;
+}
+
 // Update signature table
 int L2_ST_update(uint32_t cpu, uint64_t addr)
 {
     uint64_t curr_page = addr >> LOG2_PAGE_SIZE;
     int tag = curr_page & 0xFFFF,
         hit = 0, match = -1,
-        L2_ST_idx = curr_page % L2_ST_PRIME,
+        L2_ST_idx = L2_ST_get_set(curr_page),
         curr_block = (addr >> LOG2_BLOCK_SIZE) & 0x3F;
     SIGNATURE_TABLE *table = L2_ST[cpu][L2_ST_idx];
     int delta_buffer = 0, sig_buffer = 0;
@@ -229,10 +238,8 @@ int L2_ST_update(uint32_t cpu, uint64_t addr)
         table[match].first_hit = 0;
         table[match].last_block = curr_block;
         
-        for (int i=0; i<64; i++) {
-            table[match].l2_pf[i] = 0;
-            table[match].used[i] = 0;
-        }
+        table[match].l2_pf.reset();
+        table[match].used.reset();
 
         if (warmup_complete[cpu])
         L2_PF_DEBUG(printf("ST_miss cpu: %d cl_addr: %lx page: %lx block: %d lru: %d\n", cpu, addr >> LOG2_BLOCK_SIZE, curr_page, curr_block, table[match].lru));
@@ -296,7 +303,7 @@ int L2_ST_check(uint32_t cpu, uint64_t addr)
     uint64_t curr_page = addr >> LOG2_PAGE_SIZE;
     int tag = curr_page & 0xFFFF,
         match = -1,
-        L2_ST_idx = curr_page % L2_ST_PRIME;
+        L2_ST_idx = L2_ST_get_set(curr_page);
 
     SIGNATURE_TABLE *table = L2_ST[cpu][L2_ST_idx];
 
@@ -0,0 +1,70 @@
+#ifndef LLC_TRACE_H
+#define LLC_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// binary record of the LLC access stream, written with -llc_trace and read by scripts/llc_opt.cc
+// the file is an LLC_TRACE_HEADER followed by one LLC_TRACE_RECORD per access and per fill
+#define LLC_TRACE_MAGIC 0x5443524C // "LRCT"
+#define LLC_TRACE_VERSION 1
+
+// events
+#define LLC_TRACE_READ 0
+#define LLC_TRACE_WRITEBACK 1
+#define LLC_TRACE_PREFETCH 2
+#define LLC_TRACE_FILL 3
+
+// layout of LLC_TRACE_RECORD::info
+#define LLC_TRACE_TYPE_MASK 0x7
+#define LLC_TRACE_HIT 0x8
+#define LLC_TRACE_EVENT_SHIFT 4
+#define LLC_TRACE_EVENT_MASK 0x3
+#define LLC_TRACE_WARMUP 0x40 // the core had not finished its warmup
+
+class LLC_TRACE_HEADER {
+  public:
+    uint32_t magic,
+             version,
+             num_cpus,
+             log2_sets,
+             ways,
+             reserved;
+};
+
+class LLC_TRACE_RECORD {
+  public:
+    uint64_t tag;    // line address >> log2_sets
+    uint32_t cycle;  // cycles since the previous record, saturated
+    uint16_t set;
+    uint8_t cpu,
+            info;
+};
+
+// buffers the records and writes them out whenever the buffer fills up and at exit
+class LLC_TRACE {
+  public:
+    uint32_t SIZE, occupancy, log2_sets;
+    uint64_t last_cycle, records;
+    LLC_TRACE_RECORD *buffer;
+    FILE *out;
+
+    LLC_TRACE() {
+        SIZE = 0;
+        occupancy = 0;
+        log2_sets = 0;
+        last_cycle = 0;
+        records = 0;
+        buffer = NULL;
+        out = NULL;
+    };
+
+    void initialize(const char *filename, uint32_t num_cpus, uint32_t sets_log2, uint32_t ways),
+         record(uint32_t cpu, uint64_t address, uint32_t type, uint8_t event, uint8_t hit, uint8_t warmup, uint64_t cycle),
+         flush(),
+         finish();
+};
+
+extern LLC_TRACE llc_trace;
+
+#endif
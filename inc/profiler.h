@@ -0,0 +1,51 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "champsim.h"
+
+// host-time profiling of the simulator itself, enabled with PROFILE_STAGES in champsim.h
+// each stage accumulates rdtsc cycles through a scoped timer, nested stages are included in their parents
+#define PROF_CACHE 0 // + cache_type (IS_ITLB ... IS_LLC)
+#define PROF_PARTITION 7
+#define PROF_DRAM 8
+#define PROF_DRAM_SCHEDULE 9
+#define PROF_READ_FROM_TRACE 10
+#define PROF_FETCH 11
+#define PROF_DECODE 12
+#define PROF_SCHEDULE 13
+#define PROF_EXECUTE 14
+#define PROF_SCHEDULE_MEMORY 15
+#define PROF_EXECUTE_MEMORY 16
+#define PROF_UPDATE_ROB 17
+#define PROF_RETIRE 18
+#define NUM_PROF_STAGES 19
+
+#ifdef PROFILE_STAGES
+#include <x86intrin.h>
+
+extern uint64_t prof_cycles[NUM_PROF_STAGES], prof_calls[NUM_PROF_STAGES];
+
+class SCOPED_TIMER {
+  public:
+    uint32_t stage;
+    uint64_t begin;
+
+    SCOPED_TIMER(uint32_t v1) : stage(v1) {
+        begin = __rdtsc();
+    };
+
+    ~SCOPED_TIMER() {
+        prof_cycles[stage] += __rdtsc() - begin;
+        prof_calls[stage]++;
+    };
+};
+
+#define PROFILE(stage) SCOPED_TIMER scoped_timer(stage)
+#else
+#define PROFILE(stage)
+#endif
+
+void profile_begin(),
+     profile_end(uint64_t instructions);
+
+#endif
@@ -15,8 +15,10 @@
 #endif
 
 // Signature table parameters
-#define ST_SET 1
-#define ST_WAY 256
+// 16x16 set-associative signature table instead of a fully associative one,
+// a lookup only searches the ways of the set selected by get_hash(page)
+#define ST_SET 16
+#define ST_WAY 16
 #define ST_TAG_BIT 16
 #define ST_TAG_MASK ((1 << ST_TAG_BIT) - 1)
 #define SIG_SHIFT 3
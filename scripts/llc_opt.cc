@@ -0,0 +1,279 @@
+// Belady's MIN over an LLC access stream recorded with -llc_trace
+//
+//   g++ -O2 -std=c++11 -Iinc -o llc_opt scripts/llc_opt.cc
+//   ./llc_opt <llc_trace> [<scratch file>]
+//
+// A backward pass writes the next use of every access, shared and per core, to a scratch file.
+// The forward pass replays the OPT stack algorithm (Mattson et al. 1970) per set: at every stack
+// level the line used sooner stays and the other one moves down, so the depth of a hit is its OPT
+// stack distance and one pass gives the OPT misses of every cache size up to the LLC ways.
+// The shared stack gives OPT for the whole LLC, the per-core stacks the OPT miss curve of every
+// core in a private partition, from which the best way partitioning is the partitioned-OPT bound.
+//
+// Memory is the LLC sets times the ways for the stacks and a fixed chunk of records, plus the
+// next-use maps of the backward pass, which are proportional to the distinct lines touched
+// (per core for the private stacks), not to the number of accesses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "llc_trace.h"
+
+using namespace std;
+
+#define CHUNK (1 << 20)       // records per read
+#define NEVER UINT64_MAX      // the line is not used again
+
+class NEXT_USE {
+  public:
+    uint64_t shared,
+             own;            // next use by the same core
+};
+
+class STACK_ENTRY {
+  public:
+    uint64_t line,
+             next;
+};
+
+// records of the stream are accesses, fills only show what the simulated policy did
+bool is_access(const LLC_TRACE_RECORD &r)
+{
+    return ((r.info >> LLC_TRACE_EVENT_SHIFT) & LLC_TRACE_EVENT_MASK) != LLC_TRACE_FILL;
+}
+
+void read_at(int fd, void *buf, size_t size, off_t offset)
+{
+    if (pread(fd, buf, size, offset) != (ssize_t)size) {
+        fprintf(stderr, "short read at %ld\n", (long)offset);
+        exit(1);
+    }
+}
+
+void write_at(int fd, const void *buf, size_t size, off_t offset)
+{
+    if (pwrite(fd, buf, size, offset) != (ssize_t)size) {
+        fprintf(stderr, "short write at %ld\n", (long)offset);
+        exit(1);
+    }
+}
+
+// one access to the OPT stack of a set, returns the depth of the hit or -1 on a miss
+int stack_access(STACK_ENTRY *stack, uint32_t &len, uint32_t ways, uint64_t line, uint64_t next)
+{
+    int depth = -1;
+    for (uint32_t i=0; i<len; i++)
+        if (stack[i].line == line) {
+            depth = i;
+            break;
+        }
+
+    if (depth == 0) {
+        stack[0].next = next;
+        return 0;
+    }
+
+    STACK_ENTRY carry = stack[0];
+    stack[0].line = line;
+    stack[0].next = next;
+
+    uint32_t limit = (depth < 0) ? len : depth;
+    for (uint32_t i=1; i<limit; i++) {
+        if (stack[i].next > carry.next) {
+            STACK_ENTRY t = stack[i];
+            stack[i] = carry;
+            carry = t;
+        }
+    }
+
+    if (depth > 0)
+        stack[depth] = carry;
+    else if (len == 0)
+        len = 1;
+    else if (len < ways)
+        stack[len++] = carry;
+    // otherwise carry is the line the largest cache evicts
+
+    return depth;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <llc_trace> [<scratch file>]\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    LLC_TRACE_HEADER header;
+    read_at(fd, &header, sizeof(header), 0);
+    if ((header.magic != LLC_TRACE_MAGIC) || (header.version != LLC_TRACE_VERSION)) {
+        fprintf(stderr, "%s is not an LLC trace\n", argv[1]);
+        return 1;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    uint64_t n = (st.st_size - sizeof(header)) / sizeof(LLC_TRACE_RECORD);
+    uint32_t cpus = header.num_cpus,
+             ways = header.ways,
+             sets = 1 << header.log2_sets;
+    printf("records: %lu  cpus: %u  sets: %u  ways: %u\n", n, cpus, sets, ways);
+
+    string scratch_name = (argc > 2) ? argv[2] : string(argv[1]) + ".next";
+    int scratch = open(scratch_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (scratch < 0) {
+        perror(scratch_name.c_str());
+        return 1;
+    }
+
+    vector<LLC_TRACE_RECORD> records(CHUNK);
+    vector<NEXT_USE> next(CHUNK);
+
+    // backward pass, the next use of every access
+    {
+        unordered_map<uint64_t, uint64_t> last_shared, last_own;
+        for (uint64_t end = n; end > 0; ) {
+            uint64_t begin = (end > CHUNK) ? (end - CHUNK) : 0,
+                     count = end - begin;
+            read_at(fd, &records[0], count * sizeof(LLC_TRACE_RECORD), sizeof(header) + begin * sizeof(LLC_TRACE_RECORD));
+
+            for (uint64_t i=count; i-- > 0; ) {
+                const LLC_TRACE_RECORD &r = records[i];
+                next[i].shared = NEVER;
+                next[i].own = NEVER;
+                if (!is_access(r))
+                    continue;
+
+                uint64_t line = (r.tag << header.log2_sets) | r.set,
+                         own_key = line * cpus + r.cpu;
+
+                auto s = last_shared.find(line);
+                if (s != last_shared.end())
+                    next[i].shared = s->second;
+                last_shared[line] = begin + i;
+
+                auto o = last_own.find(own_key);
+                if (o != last_own.end())
+                    next[i].own = o->second;
+                last_own[own_key] = begin + i;
+            }
+
+            write_at(scratch, &next[0], count * sizeof(NEXT_USE), begin * sizeof(NEXT_USE));
+            end = begin;
+        }
+        printf("distinct lines: %lu\n", last_shared.size());
+    }
+
+    // forward pass, OPT stacks of the shared LLC and of every core
+    vector<STACK_ENTRY> shared_stack((uint64_t)sets * ways),
+                        own_stack((uint64_t)sets * cpus * ways);
+    vector<uint32_t> shared_len(sets, 0),
+                     own_len((uint64_t)sets * cpus, 0);
+
+    vector<uint64_t> access(cpus, 0),
+                     actual_miss(cpus, 0),
+                     shared_opt_miss(cpus, 0);
+    vector<vector<uint64_t> > own_hits(cpus, vector<uint64_t>(ways, 0)); // hits at each OPT stack depth
+
+    for (uint64_t begin = 0; begin < n; begin += CHUNK) {
+        uint64_t count = (n - begin > CHUNK) ? CHUNK : (n - begin);
+        read_at(fd, &records[0], count * sizeof(LLC_TRACE_RECORD), sizeof(header) + begin * sizeof(LLC_TRACE_RECORD));
+        read_at(scratch, &next[0], count * sizeof(NEXT_USE), begin * sizeof(NEXT_USE));
+
+        for (uint64_t i=0; i<count; i++) {
+            const LLC_TRACE_RECORD &r = records[i];
+            if (!is_access(r) || (r.cpu >= cpus))
+                continue;
+
+            uint64_t line = (r.tag << header.log2_sets) | r.set,
+                     own = (uint64_t)r.set * cpus + r.cpu;
+            int shared_depth = stack_access(&shared_stack[(uint64_t)r.set * ways], shared_len[r.set], ways, line, next[i].shared),
+                own_depth = stack_access(&own_stack[own * ways], own_len[own], ways, line, next[i].own);
+
+            // the warmup trains the stacks like it trains the simulated cache
+            if (r.info & LLC_TRACE_WARMUP)
+                continue;
+
+            access[r.cpu]++;
+            if (!(r.info & LLC_TRACE_HIT))
+                actual_miss[r.cpu]++;
+            if (shared_depth < 0)
+                shared_opt_miss[r.cpu]++;
+            if (own_depth >= 0)
+                own_hits[r.cpu][own_depth]++;
+        }
+    }
+
+    close(scratch);
+    unlink(scratch_name.c_str());
+    close(fd);
+
+    // OPT misses of every core with 1 .. ways private ways
+    vector<vector<uint64_t> > own_miss(cpus, vector<uint64_t>(ways + 1, 0));
+    for (uint32_t c=0; c<cpus; c++) {
+        own_miss[c][0] = access[c];
+        for (uint32_t w=1; w<=ways; w++)
+            own_miss[c][w] = own_miss[c][w-1] - own_hits[c][w-1];
+    }
+
+    // the way partitioning with the fewest OPT misses, every core keeps at least one way
+    vector<vector<uint64_t> > best(cpus + 1, vector<uint64_t>(ways + 1, NEVER));
+    vector<vector<uint32_t> > choice(cpus + 1, vector<uint32_t>(ways + 1, 0));
+    best[0][0] = 0;
+    for (uint32_t c=0; c<cpus; c++)
+        for (uint32_t used=0; used<=ways; used++) {
+            if (best[c][used] == NEVER)
+                continue;
+            for (uint32_t w=1; used + w <= ways; w++)
+                if (best[c][used] + own_miss[c][w] < best[c+1][used+w]) {
+                    best[c+1][used+w] = best[c][used] + own_miss[c][w];
+                    choice[c+1][used+w] = w;
+                }
+        }
+
+    uint32_t best_used = 0;
+    for (uint32_t used=0; used<=ways; used++)
+        if (best[cpus][used] < best[cpus][best_used])
+            best_used = used;
+    vector<uint32_t> allocation(cpus, 0);
+    for (uint32_t c=cpus, used=best_used; c>0; c--) {
+        allocation[c-1] = choice[c][used];
+        used -= choice[c][used];
+    }
+
+    uint64_t total_access = 0, total_actual = 0, total_shared = 0, total_partitioned = 0;
+    for (uint32_t c=0; c<cpus; c++) {
+        printf("CPU %u ACCESS: %lu  ACTUAL MISS: %lu  SHARED OPT MISS: %lu  PARTITIONED OPT MISS: %lu (%u ways)\n",
+               c, access[c], actual_miss[c], shared_opt_miss[c], own_miss[c][allocation[c]], allocation[c]);
+        printf("CPU %u OPT MISS BY WAYS:", c);
+        for (uint32_t w=1; w<=ways; w++)
+            printf(" %lu", own_miss[c][w]);
+        printf("\n");
+
+        total_access += access[c];
+        total_actual += actual_miss[c];
+        total_shared += shared_opt_miss[c];
+        total_partitioned += own_miss[c][allocation[c]];
+    }
+
+    printf("TOTAL ACCESS: %lu  ACTUAL MISS: %lu  SHARED OPT MISS: %lu  PARTITIONED OPT MISS: %lu\n",
+           total_access, total_actual, total_shared, (cpus <= ways) ? total_partitioned : 0);
+    if (total_actual)
+        printf("HEADROOM: shared OPT removes %.2f%% of the misses, partitioned OPT %.2f%%\n",
+               100.0 * ((double)total_actual - total_shared) / total_actual,
+               (cpus <= ways) ? 100.0 * ((double)total_actual - total_partitioned) / total_actual : 0);
+
+    return 0;
+}
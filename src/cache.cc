@@ -1,10 +1,64 @@
 #include "cache.h"
+#include "ooo_cpu.h"
 #include "set.h"
+#include "profiler.h"
+#include "llc_trace.h"
+#include "uncore.h"
 
 uint64_t l2pf_access = 0;
 
 uint64_t partition_count = 0; // This variable is used for call paritition only on 5 million cycles. We might make inside
 
+// bucket i of the prefetch distance histograms counts distances below 16 << i cycles, the last one the rest
+uint32_t pf_distance_bucket(uint64_t cycles)
+{
+  uint32_t bucket = 0;
+  while ((bucket < PF_DISTANCE_BUCKETS - 1) && (cycles >= (16ULL << bucket)))
+    bucket++;
+  return bucket;
+}
+
+void PF_DEDUP_FILTER::init(uint32_t num_lines)
+{
+  // one slot per line of the cache, rounded up to a power of two
+  quotient_bit = 0;
+  while ((1u << quotient_bit) < num_lines)
+    quotient_bit++;
+  remainder_tag.assign(1u << quotient_bit, 0);
+  inserts = 0;
+}
+
+uint64_t PF_DEDUP_FILTER::hash(uint64_t line)
+{
+  return (line * 2654435761) >> 4; // Knuth's multiplicative hash
+}
+
+bool PF_DEDUP_FILTER::check(uint64_t line)
+{
+  uint64_t h = hash(line);
+  uint8_t remainder = (h & ((1 << PF_DEDUP_REMAINDER_BIT) - 1)) | (1 << PF_DEDUP_REMAINDER_BIT);
+  return remainder_tag[(h >> PF_DEDUP_REMAINDER_BIT) & ((1u << quotient_bit) - 1)] == remainder;
+}
+
+void PF_DEDUP_FILTER::insert(uint64_t line)
+{
+  // age the filter, the lines the cache still holds come back with their next fill or prefetch
+  if (++inserts > remainder_tag.size())
+  {
+    fill(remainder_tag.begin(), remainder_tag.end(), 0);
+    inserts = 1;
+  }
+
+  uint64_t h = hash(line);
+  remainder_tag[(h >> PF_DEDUP_REMAINDER_BIT) & ((1u << quotient_bit) - 1)] = (h & ((1 << PF_DEDUP_REMAINDER_BIT) - 1)) | (1 << PF_DEDUP_REMAINDER_BIT);
+}
+
+void PF_DEDUP_FILTER::erase(uint64_t line)
+{
+  if (check(line))
+    remainder_tag[(hash(line) >> PF_DEDUP_REMAINDER_BIT) & ((1u << quotient_bit) - 1)] = 0;
+}
+
 void CACHE::handle_fill()
 {
   // handle fill
@@ -26,7 +80,16 @@ void CACHE::handle_fill()
     uint32_t set = get_set(MSHR.entry[mshr_index].address), way;
     if (cache_type == IS_LLC)
     {
-      way = llc_find_victim(fill_cpu, MSHR.entry[mshr_index].instr_id, set, block[set], MSHR.entry[mshr_index].ip, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].type);
+      int pf_way = (MSHR.entry[mshr_index].type == PREFETCH) ? llc_pf_cap_victim(llc_owner(set, fill_cpu), set) : -1;
+      // an exclusive LLC lets the lines of the upper levels pass by, they come back as L2C victims
+      if ((knob_llc_inclusion == LLC_EXCLUSIVE) && (MSHR.entry[mshr_index].fill_level < fill_level))
+        way = LLC_WAY;
+      else if (pf_way >= 0)
+        way = pf_way;
+      else if (knob_llc_partition == LLC_PART_LINES)
+        way = llc_futility_victim(fill_cpu, set);
+      else
+        way = llc_find_victim(llc_owner(set, fill_cpu), MSHR.entry[mshr_index].instr_id, set, block[set], MSHR.entry[mshr_index].ip, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].type);
     }
     else
       way = find_victim(fill_cpu, MSHR.entry[mshr_index].instr_id, set, block[set], MSHR.entry[mshr_index].ip, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].type);
@@ -35,17 +98,24 @@ void CACHE::handle_fill()
     if ((cache_type == IS_LLC) && (way == LLC_WAY))
     { // this is a bypass that does not fill the LLC
 
-      // update replacement policy
-      if (cache_type == IS_LLC)
+      if (knob_llc_inclusion == LLC_INCLUSIVE)
       {
-        llc_update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, 0, MSHR.entry[mshr_index].type, 0);
+        cerr << "LLC bypassing is not allowed in an inclusive LLC!" << endl;
+        assert(0);
       }
-      else
+
+      // update replacement policy, the policy never chose to bypass what an exclusive LLC passes by
+      if ((cache_type == IS_LLC) && (knob_llc_inclusion != LLC_EXCLUSIVE))
+      {
+        llc_update_replacement_state(llc_owner(set, fill_cpu), set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, 0, MSHR.entry[mshr_index].type, 0);
+      }
+      else if (cache_type != IS_LLC)
         update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, 0, MSHR.entry[mshr_index].type, 0);
 
       // COLLECT STATS
       sim_miss[fill_cpu][MSHR.entry[mshr_index].type]++;
       sim_access[fill_cpu][MSHR.entry[mshr_index].type]++;
+      trace_llc(&MSHR.entry[mshr_index], LLC_TRACE_FILL, 0);
 
       // check fill level
       if (MSHR.entry[mshr_index].fill_level < fill_level)
@@ -86,10 +156,11 @@ void CACHE::handle_fill()
     }
 #endif
 
-    uint8_t do_fill = 1;
+    uint8_t do_fill = 1,
+            victim_writeback = writeback_victim(set, way);
 
     // is this dirty?
-    if (block[set][way].dirty)
+    if (victim_writeback)
     {
 
       // check if the lower level WQ has enough room to keep this writeback request
@@ -120,6 +191,7 @@ void CACHE::handle_fill()
           writeback_packet.instr_id = MSHR.entry[mshr_index].instr_id;
           writeback_packet.ip = 0; // writeback does not have ip
           writeback_packet.type = WRITEBACK;
+          writeback_packet.clean_victim = (victim_writeback == VICTIM_CLEAN);
           writeback_packet.event_cycle = current_core_cycle[fill_cpu];
 
           lower_level->add_wq(&writeback_packet);
@@ -137,6 +209,10 @@ void CACHE::handle_fill()
 
     if (do_fill)
     {
+      // an inclusive LLC takes its victim out of the upper levels
+      if ((cache_type == IS_LLC) && (knob_llc_inclusion == LLC_INCLUSIVE) && block[set][way].valid)
+        back_invalidate(block[set][way].address);
+
       // update prefetcher
       if (cache_type == IS_L1I)
         l1i_prefetcher_cache_fill(fill_cpu, ((MSHR.entry[mshr_index].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, ((block[set][way].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
@@ -157,7 +233,9 @@ void CACHE::handle_fill()
       // update replacement policy
       if (cache_type == IS_LLC)
       {
-        llc_update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, block[set][way].full_addr, MSHR.entry[mshr_index].type, 0);
+        if (knob_llc_partition == LLC_PART_LINES)
+          futility_fill(fill_cpu, set, way);
+        llc_update_replacement_state(llc_owner(set, fill_cpu), set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, block[set][way].full_addr, MSHR.entry[mshr_index].type, 0);
       }
       else
         update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, block[set][way].full_addr, MSHR.entry[mshr_index].type, 0);
@@ -165,6 +243,7 @@ void CACHE::handle_fill()
       // COLLECT STATS
       sim_miss[fill_cpu][MSHR.entry[mshr_index].type]++;
       sim_access[fill_cpu][MSHR.entry[mshr_index].type]++;
+      trace_llc(&MSHR.entry[mshr_index], LLC_TRACE_FILL, 0);
 
       fill_cache(set, way, &MSHR.entry[mshr_index]);
 
@@ -261,14 +340,15 @@ void CACHE::handle_writeback()
     int way = check_hit(&WQ.entry[index]);
 
     // Checking for hits in the ATD whenever we check for hit in the LLC
-    if (cache_type == IS_LLC && set % (NUM_SET / 32) == 0)
+    int atd_s = (cache_type == IS_LLC) ? atd_set(WQ.entry[index].address) : -1;
+    if (atd_s >= 0)
     {
       int atd_way = check_hit_atd(&WQ.entry[index]); // Checking for hit in the ATD
       if (atd_way == -1)
       {
-        int way_r = atd_lru_victim(WQ.entry[index].cpu, set / (NUM_SET / 32)); // Finding way to be replaced in ATD
-        fill_atd(set / (NUM_SET / 32), way_r, &WQ.entry[index]);               // Placing the the requested packet in cpu
-        atd_lru_update(set / (NUM_SET / 32), way_r, WQ.entry[index].cpu);      // Updating the lru values in ATD
+        int way_r = atd_lru_victim(WQ.entry[index].cpu, atd_s); // Finding way to be replaced in ATD
+        fill_atd(atd_s, way_r, &WQ.entry[index]);               // Placing the the requested packet in cpu
+        atd_lru_update(atd_s, way_r, WQ.entry[index].cpu);      // Updating the lru values in ATD
       }
     }
 
@@ -277,7 +357,7 @@ void CACHE::handle_writeback()
 
       if (cache_type == IS_LLC)
       {
-        llc_update_replacement_state(writeback_cpu, set, way, block[set][way].full_addr, WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
+        llc_update_replacement_state(llc_owner(set, writeback_cpu), set, way, block[set][way].full_addr, WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
       }
       else
         update_replacement_state(writeback_cpu, set, way, block[set][way].full_addr, WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
@@ -287,7 +367,10 @@ void CACHE::handle_writeback()
       sim_access[writeback_cpu][WQ.entry[index].type]++;
 
       // mark dirty
-      block[set][way].dirty = 1;
+      if (WQ.entry[index].clean_victim == 0)
+        block[set][way].dirty = 1;
+      else
+        clean_victims[writeback_cpu]++;
 
       if (cache_type == IS_ITLB)
         WQ.entry[index].instruction_pa = block[set][way].data;
@@ -322,6 +405,7 @@ void CACHE::handle_writeback()
 
       HIT[WQ.entry[index].type]++;
       ACCESS[WQ.entry[index].type]++;
+      trace_llc(&WQ.entry[index], LLC_TRACE_WRITEBACK, 1);
 
       // remove this entry from WQ
       WQ.remove_queue(&WQ.entry[index]);
@@ -431,6 +515,7 @@ void CACHE::handle_writeback()
 
           MISS[WQ.entry[index].type]++;
           ACCESS[WQ.entry[index].type]++;
+          trace_llc(&WQ.entry[index], LLC_TRACE_WRITEBACK, 0);
 
           // remove this entry from WQ
           WQ.remove_queue(&WQ.entry[index]);
@@ -440,9 +525,11 @@ void CACHE::handle_writeback()
       {
         // find victim
         uint32_t set = get_set(WQ.entry[index].address), way;
-        if (cache_type == IS_LLC)
+        if ((cache_type == IS_LLC) && (knob_llc_partition == LLC_PART_LINES))
+          way = llc_futility_victim(writeback_cpu, set);
+        else if (cache_type == IS_LLC)
         {
-          way = llc_find_victim(writeback_cpu, WQ.entry[index].instr_id, set, block[set], WQ.entry[index].ip, WQ.entry[index].full_addr, WQ.entry[index].type);
+          way = llc_find_victim(llc_owner(set, writeback_cpu), WQ.entry[index].instr_id, set, block[set], WQ.entry[index].ip, WQ.entry[index].full_addr, WQ.entry[index].type);
         }
         else
           way = find_victim(writeback_cpu, WQ.entry[index].instr_id, set, block[set], WQ.entry[index].ip, WQ.entry[index].full_addr, WQ.entry[index].type);
@@ -455,10 +542,11 @@ void CACHE::handle_writeback()
         }
 #endif
 
-        uint8_t do_fill = 1;
+        uint8_t do_fill = 1,
+                victim_writeback = writeback_victim(set, way);
 
         // is this dirty?
-        if (block[set][way].dirty)
+        if (victim_writeback)
         {
 
           // check if the lower level WQ has enough room to keep this writeback request
@@ -489,6 +577,7 @@ void CACHE::handle_writeback()
               writeback_packet.instr_id = WQ.entry[index].instr_id;
               writeback_packet.ip = 0;
               writeback_packet.type = WRITEBACK;
+              writeback_packet.clean_victim = (victim_writeback == VICTIM_CLEAN);
               writeback_packet.event_cycle = current_core_cycle[writeback_cpu];
 
               lower_level->add_wq(&writeback_packet);
@@ -506,6 +595,10 @@ void CACHE::handle_writeback()
 
         if (do_fill)
         {
+          // an inclusive LLC takes its victim out of the upper levels
+          if ((cache_type == IS_LLC) && (knob_llc_inclusion == LLC_INCLUSIVE) && block[set][way].valid)
+            back_invalidate(block[set][way].address);
+
           // update prefetcher
           if (cache_type == IS_L1I)
             l1i_prefetcher_cache_fill(writeback_cpu, ((WQ.entry[index].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way, 0, ((block[set][way].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
@@ -525,7 +618,9 @@ void CACHE::handle_writeback()
           // update replacement policy
           if (cache_type == IS_LLC)
           {
-            llc_update_replacement_state(writeback_cpu, set, way, WQ.entry[index].full_addr, WQ.entry[index].ip, block[set][way].full_addr, WQ.entry[index].type, 0);
+            if (knob_llc_partition == LLC_PART_LINES)
+              futility_fill(writeback_cpu, set, way);
+            llc_update_replacement_state(llc_owner(set, writeback_cpu), set, way, WQ.entry[index].full_addr, WQ.entry[index].ip, block[set][way].full_addr, WQ.entry[index].type, 0);
           }
           else
             update_replacement_state(writeback_cpu, set, way, WQ.entry[index].full_addr, WQ.entry[index].ip, block[set][way].full_addr, WQ.entry[index].type, 0);
@@ -537,7 +632,10 @@ void CACHE::handle_writeback()
           fill_cache(set, way, &WQ.entry[index]);
 
           // mark dirty
-          block[set][way].dirty = 1;
+          if (WQ.entry[index].clean_victim == 0)
+            block[set][way].dirty = 1;
+          else
+            clean_victims[writeback_cpu]++;
 
           // check fill level
           if (WQ.entry[index].fill_level < fill_level)
@@ -565,6 +663,7 @@ void CACHE::handle_writeback()
 
           MISS[WQ.entry[index].type]++;
           ACCESS[WQ.entry[index].type]++;
+          trace_llc(&WQ.entry[index], LLC_TRACE_WRITEBACK, 0);
 
           // remove this entry from WQ
           WQ.remove_queue(&WQ.entry[index]);
@@ -594,18 +693,19 @@ void CACHE::handle_read()
       int way = check_hit(&RQ.entry[index]);
 
       // Checking for hits in the ATD whenever we check for hit in the LLC
-      if (cache_type == IS_LLC && set % (NUM_SET / 32) == 0)
+      int atd_s = (cache_type == IS_LLC) ? atd_set(RQ.entry[index].address) : -1;
+      if (atd_s >= 0)
       {
         int atd_way = check_hit_atd(&RQ.entry[index]);
         if (atd_way == -1)
         {
-          int way_r = atd_lru_victim(RQ.entry[index].cpu, set / (NUM_SET / 32)); // Finding way to be replaced in ATD
-          fill_atd(set / (NUM_SET / 32), way_r, &RQ.entry[index]);               // Placing the the requested packet in cpu
-          atd_lru_update(set / (NUM_SET / 32), way_r, RQ.entry[index].cpu);      // Updating the lru values in ATD
+          int way_r = atd_lru_victim(RQ.entry[index].cpu, atd_s); // Finding way to be replaced in ATD
+          fill_atd(atd_s, way_r, &RQ.entry[index]);               // Placing the the requested packet in cpu
+          atd_lru_update(atd_s, way_r, RQ.entry[index].cpu);      // Updating the lru values in ATD
         }
         else
         {
-          atd_lru_update(set / (NUM_SET / 32), atd_way, RQ.entry[index].cpu); // Updating the lru values in ATD
+          atd_lru_update(atd_s, atd_way, RQ.entry[index].cpu); // Updating the lru values in ATD
         }
       }
 
@@ -658,7 +758,7 @@ void CACHE::handle_read()
         // update replacement policy
         if (cache_type == IS_LLC)
         {
-          llc_update_replacement_state(read_cpu, set, way, block[set][way].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
+          llc_update_replacement_state(llc_owner(set, read_cpu), set, way, block[set][way].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
         }
         else
           update_replacement_state(read_cpu, set, way, block[set][way].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
@@ -695,12 +795,18 @@ void CACHE::handle_read()
         if (block[set][way].prefetch)
         {
           pf_useful++;
+          record_pf_use(&block[set][way], current_core_cycle[read_cpu]);
           block[set][way].prefetch = 0;
         }
         block[set][way].used = 1;
 
+        // an exclusive LLC hands the line up to the L2C
+        if ((cache_type == IS_LLC) && (knob_llc_inclusion == LLC_EXCLUSIVE) && (RQ.entry[index].fill_level < fill_level))
+          exclusive_move_up(set, way, read_cpu);
+
         HIT[RQ.entry[index].type]++;
         ACCESS[RQ.entry[index].type]++;
+        trace_llc(&RQ.entry[index], LLC_TRACE_READ, 1);
 
         // remove this entry from RQ
         RQ.remove_queue(&RQ.entry[index]);
@@ -855,6 +961,13 @@ void CACHE::handle_read()
             // update request
             if (MSHR.entry[mshr_index].type == PREFETCH)
             {
+              if (RQ.entry[index].type != PREFETCH)
+              {
+                pf_late++;
+                if (MSHR.entry[mshr_index].cycle_enqueued)
+                  pf_late_distance[pf_distance_bucket(current_core_cycle[read_cpu] - MSHR.entry[mshr_index].cycle_enqueued)]++;
+              }
+
               uint8_t prior_returned = MSHR.entry[mshr_index].returned;
               uint64_t prior_event_cycle = MSHR.entry[mshr_index].event_cycle;
               MSHR.entry[mshr_index] = RQ.entry[index];
@@ -901,6 +1014,7 @@ void CACHE::handle_read()
 
           MISS[RQ.entry[index].type]++;
           ACCESS[RQ.entry[index].type]++;
+          trace_llc(&RQ.entry[index], LLC_TRACE_READ, 0);
 
           // remove this entry from RQ
           RQ.remove_queue(&RQ.entry[index]);
@@ -940,13 +1054,26 @@ void CACHE::handle_prefetch()
       uint32_t set = get_set(PQ.entry[index].address);
       int way = check_hit(&PQ.entry[index]);
 
+      // Modelling prefetch fills in the ATD, prefetch hits do not count as utility and do not promote the line
+      int atd_s = (cache_type == IS_LLC && knob_ucp_prefetch) ? atd_set(PQ.entry[index].address) : -1;
+      if (atd_s >= 0)
+      {
+        int atd_way = check_hit_atd(&PQ.entry[index]);
+        if (atd_way == -1)
+        {
+          int way_r = atd_lru_victim(PQ.entry[index].cpu, atd_s);
+          fill_atd(atd_s, way_r, &PQ.entry[index]);
+          atd_lru_update(atd_s, way_r, PQ.entry[index].cpu);
+        }
+      }
+
       if (way >= 0)
       { // prefetch hit
 
         // update replacement policy
         if (cache_type == IS_LLC)
         {
-          llc_update_replacement_state(prefetch_cpu, set, way, block[set][way].full_addr, PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
+          llc_update_replacement_state(llc_owner(set, prefetch_cpu), set, way, block[set][way].full_addr, PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
         }
         else
           update_replacement_state(prefetch_cpu, set, way, block[set][way].full_addr, PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
@@ -994,8 +1121,12 @@ void CACHE::handle_prefetch()
           }
         }
 
+        if ((cache_type == IS_LLC) && (knob_llc_inclusion == LLC_EXCLUSIVE) && (PQ.entry[index].fill_level < fill_level))
+          exclusive_move_up(set, way, prefetch_cpu);
+
         HIT[PQ.entry[index].type]++;
         ACCESS[PQ.entry[index].type]++;
+        trace_llc(&PQ.entry[index], LLC_TRACE_PREFETCH, 1);
 
         // remove this entry from PQ
         PQ.remove_queue(&PQ.entry[index]);
@@ -1136,6 +1267,7 @@ void CACHE::handle_prefetch()
 
           MISS[PQ.entry[index].type]++;
           ACCESS[PQ.entry[index].type]++;
+          trace_llc(&PQ.entry[index], LLC_TRACE_PREFETCH, 0);
 
           // remove this entry from PQ
           PQ.remove_queue(&PQ.entry[index]);
@@ -1157,10 +1289,13 @@ void CACHE::handle_prefetch()
 
 void CACHE::operate()
 {
+  PROFILE(PROF_CACHE + cache_type);
+
   if (NAME == "LLC")
   {
     if (current_core_cycle[0] / 5000000 != partition_count)
     {
+      PROFILE(PROF_PARTITION);
       vector<uint32_t> new_allocations = partition_algorithm();
       if (partition_count == 0)
         cerr << "Partition Changes every 5000000 cycles:\n";
@@ -1168,6 +1303,10 @@ void CACHE::operate()
       for (auto i : new_allocations)
         cerr << i << ' ';
       cerr << endl;
+      partition_history.push_back(make_pair((partition_count + 1) * 5000000, new_allocations));
+      // with page coloring the allocations are colors and with line partitioning lines, every core keeps all the ways
+      if (knob_llc_partition != LLC_PART_WAYS)
+        new_allocations.assign(NUM_CPUS, NUM_WAY);
       vector<uint32_t> extra;     // Contains apps with extra ways
       vector<uint32_t> deficient; // Contains apps with deficient ways
       for (uint32_t application = 0; application < NUM_CPUS; application++)
@@ -1182,7 +1321,8 @@ void CACHE::operate()
           deficient.push_back(application); // Counting the number of cores which need more ways
         }
       }
-      for (int set = 0; set < NUM_SET; set++)
+      // a pseudo-partitioning policy keeps every way shared, the allocations only set where each core inserts
+      for (int set = 0; (set < NUM_SET) && !pseudo_partition; set++)
       {
         vector<uint32_t> to_allocate;
         for (int way = 0; way < NUM_WAY; way++)
@@ -1251,6 +1391,49 @@ uint32_t CACHE::get_way(uint64_t address, uint32_t set)
   return NUM_WAY;
 }
 
+void CACHE::reset_pf_timeliness()
+{
+  for (uint32_t i = 0; i < PF_DISTANCE_BUCKETS; i++)
+  {
+    pf_use_distance[i] = 0;
+    pf_late_distance[i] = 0;
+  }
+  for (uint32_t i = 0; i < PF_DEPTH_BUCKETS; i++)
+  {
+    pf_useful_depth[i] = 0;
+    pf_useless_depth[i] = 0;
+  }
+  for (uint32_t i = 0; i < PF_CONF_BUCKETS; i++)
+  {
+    pf_useful_conf[i] = 0;
+    pf_useless_conf[i] = 0;
+  }
+}
+
+void CACHE::record_pf_use(BLOCK *b, uint64_t cycle)
+{
+  // first demand use of a prefetched block
+  pf_use_distance[pf_distance_bucket((cycle > b->fill_cycle) ? (cycle - b->fill_cycle) : 0)]++;
+  pf_useful_depth[min(max(b->depth, 0), PF_DEPTH_BUCKETS - 1)]++;
+  pf_useful_conf[min(max(b->confidence / 10, 0), PF_CONF_BUCKETS - 1)]++;
+}
+
+void CACHE::record_pf_useless(BLOCK *b)
+{
+  // prefetched block evicted before its first use
+  pf_useless_depth[min(max(b->depth, 0), PF_DEPTH_BUCKETS - 1)]++;
+  pf_useless_conf[min(max(b->confidence / 10, 0), PF_CONF_BUCKETS - 1)]++;
+}
+
+// record an LLC access or fill for the offline OPT analysis (-llc_trace)
+void CACHE::trace_llc(PACKET *packet, uint8_t event, uint8_t hit)
+{
+  if ((cache_type != IS_LLC) || (llc_trace.out == NULL))
+    return;
+
+  llc_trace.record(packet->cpu, packet->address, packet->type, event, hit, !warmup_complete[packet->cpu], current_core_cycle[packet->cpu]);
+}
+
 void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
 {
 #ifdef SANITY_CHECK
@@ -1273,7 +1456,10 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
   }
 #endif
   if (block[set][way].prefetch && (block[set][way].used == 0))
+  {
     pf_useless++;
+    record_pf_useless(&block[set][way]);
+  }
 
   if (block[set][way].valid == 0)
     block[set][way].valid = 1;
@@ -1288,13 +1474,22 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
   block[set][way].depth = packet->depth;
   block[set][way].signature = packet->signature;
   block[set][way].confidence = packet->confidence;
+  block[set][way].fill_cycle = current_core_cycle[packet->cpu];
+
+  // the evicted line may be prefetched again, the filled one is resident
+  if (knob_pf_dedup)
+  {
+    if (block[set][way].valid)
+      pf_filter.erase(block[set][way].address);
+    pf_filter.insert(packet->address);
+  }
 
   block[set][way].tag = packet->address;
   block[set][way].address = packet->address;
   block[set][way].full_addr = packet->full_addr;
   block[set][way].data = packet->data;
   block[set][way].ip = packet->ip;
-  block[set][way].cpu = packet->cpu;
+  block[set][way].cpu = (cache_type == IS_LLC) ? llc_owner(set, packet->cpu) : packet->cpu;
   block[set][way].instr_id = packet->instr_id;
 
   DP(if (warmup_complete[packet->cpu]) {
@@ -1315,8 +1510,13 @@ void CACHE::fill_atd(uint32_t set, uint32_t way, PACKET *packet)
   {
     atd[curr_cpu][set][way].valid = 1;
   }
+  else if (atd[curr_cpu][set][way].prefetch && (atd[curr_cpu][set][way].used == 0))
+  {
+    pf_useless_atd[curr_cpu]++;
+  }
 
   atd[curr_cpu][set][way].dirty = 0;
+  atd[curr_cpu][set][way].prefetch = (packet->type == PREFETCH) ? 1 : 0;
   atd[curr_cpu][set][way].used = 0;
   atd[curr_cpu][set][way].depth = packet->depth;
   atd[curr_cpu][set][way].signature = packet->signature;
@@ -1370,7 +1570,7 @@ int CACHE::check_hit(PACKET *packet)
   {
     for (uint32_t way = 0; way < NUM_WAY; way++)
     {
-      if (block[set][way].valid && (block[set][way].tag == packet->address) && block[set][way].cpu == packet->cpu)
+      if (block[set][way].valid && (block[set][way].tag == packet->address) && block[set][way].cpu == llc_owner(set, packet->cpu))
       {
 
         match_way = way;
@@ -1388,22 +1588,71 @@ int CACHE::check_hit(PACKET *packet)
   return match_way;
 }
 
+int CACHE::llc_pf_cap_victim(uint32_t cpu, uint32_t set)
+{
+  /*
+    Limits the number of prefetched and not yet used lines a core holds in a set of its partition
+    Returns the least recently used of them once the core reached the cap, -1 otherwise
+  */
+  if (knob_ucp_pf_ways == 0)
+    return -1;
+
+  uint32_t pf_lines = 0;
+  int victim = -1;
+  for (uint32_t way = 0; way < NUM_WAY; way++)
+  {
+    if (block[set][way].valid && (block[set][way].cpu == cpu) && block[set][way].prefetch && (block[set][way].used == 0))
+    {
+      pf_lines++;
+      if ((victim == -1) || (block[set][way].lru > block[set][victim].lru))
+        victim = way;
+    }
+  }
+
+  return (pf_lines >= knob_ucp_pf_ways) ? victim : -1;
+}
+
+int CACHE::atd_set(uint64_t address)
+{
+  /*
+    The ATD set a line maps to, -1 if its LLC set is not sampled. With page coloring the color bits of a physical
+    page follow the partition, so the bits above the set index (random for a freshly drawn page) stand in for them
+    and the ATD still sees every core alone in the whole LLC
+  */
+  uint32_t set = get_set(address);
+  if (knob_llc_partition == LLC_PART_COLORS)
+    set = (set & ((1 << LOG2_COLOR_SETS) - 1)) | (((address >> lg2(NUM_SET)) & (LLC_COLORS - 1)) << LOG2_COLOR_SETS);
+  if (set % (NUM_SET / 32))
+    return -1;
+  return set / (NUM_SET / 32);
+}
+
 int CACHE::check_hit_atd(PACKET *packet)
 {
   /*
     Checking for hit in the ATD
   */
-  uint32_t set = get_set(packet->address) / (NUM_SET / 32); // Mapping requested in the ATD
+  uint32_t set = atd_set(packet->address); // Mapping requested in the ATD
   int match_way = -1;
   int curr_cpu = packet->cpu; // Finding the CPU of the requested packet
 
+  if ((NAME == "LLC") && (packet->type != PREFETCH))
+    atd_access[curr_cpu]++;
+
   if (NAME == "LLC")
     for (uint32_t way = 0; way < NUM_WAY; way++)
     {
       if (atd[curr_cpu][set][way].valid && (atd[curr_cpu][set][way].tag == packet->address)) // Checking for hit in each of the ways in ATD of requested CPU
       {
         match_way = way;
-        hit_counts[curr_cpu][atd[curr_cpu][set][way].lru]++; // Incrementing the hit counts of the LRU position of the ATD
+        if (packet->type == PREFETCH) // Prefetches only find out that the line is present
+          break;
+
+        if (atd[curr_cpu][set][way].prefetch && (atd[curr_cpu][set][way].used == 0))
+          pf_hit_counts[curr_cpu][atd[curr_cpu][set][way].lru]++; // First demand use of a prefetched line
+        else
+          hit_counts[curr_cpu][atd[curr_cpu][set][way].lru]++; // Incrementing the hit counts of the LRU position of the ATD
+        atd[curr_cpu][set][way].used = 1;
         DP(if (warmup_complete[packet->cpu]) {
               cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
               cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
@@ -1435,6 +1684,10 @@ int CACHE::invalidate_entry(uint64_t inval_addr)
     {
 
       block[set][way].valid = 0;
+      if (knob_pf_dedup)
+        pf_filter.erase(block[set][way].address);
+      if ((cache_type == IS_LLC) && (knob_llc_partition == LLC_PART_LINES))
+        owned_lines[block[set][way].cpu]--;
 
       match_way = way;
 
@@ -1450,6 +1703,82 @@ int CACHE::invalidate_entry(uint64_t inval_addr)
   return match_way;
 }
 
+uint8_t CACHE::writeback_victim(uint32_t set, uint32_t way)
+{
+  /*
+    Whether the victim of a fill goes to the lower level: VICTIM_DIRTY for dirty lines, VICTIM_CLEAN for the other
+    L2C victims with an exclusive LLC, 0 when it is dropped. For an inclusive LLC a dirty copy in the upper levels
+    makes the victim dirty. This is only a query, the upper level copies are invalidated once the fill is committed
+  */
+  if (block[set][way].dirty)
+    return VICTIM_DIRTY;
+  if ((cache_type == IS_LLC) && (knob_llc_inclusion == LLC_INCLUSIVE) && block[set][way].valid && upper_dirty(block[set][way].address))
+    return VICTIM_DIRTY;
+  if ((cache_type == IS_L2C) && (knob_llc_inclusion == LLC_EXCLUSIVE) && block[set][way].valid)
+    return VICTIM_CLEAN;
+  return 0;
+}
+
+uint8_t CACHE::upper_dirty(uint64_t address)
+{
+  // Whether the L2C, L1D or L1I of some core holds a dirty copy of a line, without touching it
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    CACHE *upper[3] = {&ooo_cpu[i].L2C, &ooo_cpu[i].L1D, &ooo_cpu[i].L1I};
+    for (uint32_t c = 0; c < 3; c++)
+    {
+      uint32_t set = upper[c]->get_set(address);
+      for (uint32_t way = 0; way < upper[c]->NUM_WAY; way++)
+        if (upper[c]->block[set][way].valid && (upper[c]->block[set][way].tag == address) && upper[c]->block[set][way].dirty)
+          return 1;
+    }
+  }
+
+  return 0;
+}
+
+uint8_t CACHE::back_invalidate(uint64_t address)
+{
+  // Invalidates a line in the L2C, L1D and L1I of every core, returns whether one of the copies was dirty
+  uint8_t dirty = 0;
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    CACHE *upper[3] = {&ooo_cpu[i].L2C, &ooo_cpu[i].L1D, &ooo_cpu[i].L1I};
+    for (uint32_t c = 0; c < 3; c++)
+    {
+      int way = upper[c]->invalidate_entry(address);
+      if (way < 0)
+        continue;
+
+      BLOCK *b = &upper[c]->block[upper[c]->get_set(address)][way];
+      back_invalidations[i]++;
+      if (b->dirty)
+      {
+        back_invalidation_writebacks[i]++;
+        b->dirty = 0;
+        dirty = 1;
+      }
+    }
+  }
+
+  return dirty;
+}
+
+void CACHE::exclusive_move_up(uint32_t set, uint32_t way, uint32_t cpu)
+{
+  // The line leaves the LLC for the L2C, which fills it clean. A dirty line stays until it is evicted,
+  // so that its data still reaches DRAM
+  if (block[set][way].dirty)
+    return;
+
+  block[set][way].valid = 0;
+  if (knob_pf_dedup)
+    pf_filter.erase(block[set][way].address);
+  if (knob_llc_partition == LLC_PART_LINES)
+    owned_lines[block[set][way].cpu]--;
+  moved_up[cpu]++;
+}
+
 int CACHE::add_rq(PACKET *packet)
 {
   // check for the latest wirtebacks in the write queue
@@ -1668,6 +1997,24 @@ int CACHE::add_wq(PACKET *packet)
   return -1;
 }
 
+// drops a prefetch to a line this cache recently prefetched or holds, a prefetch that only fills a lower level
+// is not recorded so that it can still be promoted to this level later, as SPP does with its LLC prefetches
+bool CACHE::pf_dedup(uint64_t pf_addr, int pf_fill_level)
+{
+  if (!knob_pf_dedup)
+    return false;
+
+  uint64_t pf_line = pf_addr >> LOG2_BLOCK_SIZE;
+  if (pf_filter.check(pf_line))
+  {
+    pf_filtered++;
+    return true;
+  }
+  if (pf_fill_level <= fill_level)
+    pf_filter.insert(pf_line);
+  return false;
+}
+
 int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, uint32_t prefetch_metadata)
 {
   pf_requested++;
@@ -1676,6 +2023,8 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
   {
     if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE))
     {
+      if (pf_dedup(pf_addr, pf_fill_level))
+        return 0;
 
       PACKET pf_packet;
       pf_packet.fill_level = pf_fill_level;
@@ -1708,12 +2057,16 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
   return 0;
 }
 
-int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata)
+int CACHE::kpc_prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata)
 {
+  pf_requested++;
+
   if (PQ.occupancy < PQ.SIZE)
   {
     if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE))
     {
+      if (pf_dedup(pf_addr, pf_fill_level))
+        return 0;
 
       PACKET pf_packet;
       pf_packet.fill_level = pf_fill_level;
@@ -1730,7 +2083,7 @@ int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int pf_fill_l
       pf_packet.full_addr = pf_addr;
       // pf_packet.instr_id = LQ.entry[lq_index].instr_id;
       // pf_packet.rob_index = LQ.entry[lq_index].rob_index;
-      pf_packet.ip = 0;
+      pf_packet.ip = ip;
       pf_packet.type = PREFETCH;
       pf_packet.delta = delta;
       pf_packet.depth = depth;
@@ -1911,6 +2264,15 @@ void CACHE::return_data(PACKET *packet)
     cout << " event: " << MSHR.entry[mshr_index].event_cycle << " current: " << current_core_cycle[packet->cpu] << " next: " << MSHR.next_fill_cycle << endl; });
 }
 
+void CACHE::return_metadata(PACKET *packet)
+{
+  // metadata is not filled on the way up, only the prefetcher that requested it sees it
+  if (packet->pf_origin_level == fill_level)
+    metadata_returned.push_back(packet->address);
+  else if (upper_level_dcache[packet->cpu])
+    upper_level_dcache[packet->cpu]->return_metadata(packet);
+}
+
 void CACHE::update_fill_cycle()
 {
   // update next_fill_cycle
@@ -2051,20 +2413,153 @@ void CACHE::increment_WQ_FULL(uint64_t address)
 float CACHE::get_mu_value(uint32_t core, uint32_t a, uint32_t b)
 {
   // Function calculate the marginal utility value for the core given as arguement
+  if (knob_ucp_objective != UCP_OBJ_HITS)
+    return (ucp_utility(core, b) - ucp_utility(core, a)) / (b - a);
+
   vector<vector<int>> arr(NUM_CPUS);
   for (uint32_t i = 0; i < NUM_CPUS; i++)
   {
     // We create a prefix array that will be used to calculate the difference in misses between different allocations
-    arr[i].push_back(hit_counts[i][0]);
+    arr[i].push_back(ucp_hits(i, 0));
     for (uint32_t j = 1; j < NUM_WAY; j++)
     {
-      arr[i].push_back(arr[i][j - 1] + hit_counts[i][j]);
+      arr[i].push_back(arr[i][j - 1] + ucp_hits(i, j));
     }
   }
   // U is the difference in misses when the core is allocated different number of ways
   int U = arr[core][b - 1] - arr[core][a - 1];
   // Marginal utility = (missa - missb) / (b-a)
-  return (float)U / (float)(b - a);
+  float mu = (float)U / (float)(b - a);
+  // Every prefetch that was evicted unused occupied a line without saving a miss, it is charged to the issuing core evenly over all ways
+  if (knob_ucp_prefetch == UCP_PF_CHARGE)
+    mu -= (float)pf_useless_atd[core] / NUM_WAY;
+  return mu;
+}
+
+uint64_t CACHE::ucp_hits(uint32_t core, uint32_t position)
+{
+  // ATD hits at the given LRU position that count as utility for the partitioning objective
+  if (knob_ucp_prefetch == UCP_PF_DEMAND)
+    return hit_counts[core][position];
+  return hit_counts[core][position] + pf_hit_counts[core][position];
+}
+
+void CACHE::ucp_update_model()
+{
+  // Instructions and cycles of every core since the previous repartitioning
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    ucp_epoch_instr[i] = ooo_cpu[i].num_retired - ucp_last_instr[i];
+    ucp_epoch_cycle[i] = current_core_cycle[i] - ucp_last_cycle[i];
+    ucp_last_instr[i] = ooo_cpu[i].num_retired;
+    ucp_last_cycle[i] = current_core_cycle[i];
+
+    ucp_epoch_interference[i] = uncore.DRAM.core_interference[i] - ucp_last_interference[i];
+    ucp_last_interference[i] = uncore.DRAM.core_interference[i];
+    ucp_epoch_reads[i] = uncore.DRAM.core_reads[i] - ucp_last_reads[i];
+    ucp_last_reads[i] = uncore.DRAM.core_reads[i];
+  }
+
+  // A miss costs its average latency over the overlapped misses, the warmup resets the counters
+  uint64_t miss = 0;
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    miss += sim_miss[i][LOAD] + sim_miss[i][RFO];
+  uint64_t epoch_miss = (miss >= ucp_last_miss) ? (miss - ucp_last_miss) : miss,
+           epoch_latency = (total_miss_latency >= ucp_last_latency) ? (total_miss_latency - ucp_last_latency) : total_miss_latency;
+  if (epoch_miss && epoch_latency)
+    ucp_miss_penalty = (double)epoch_latency / epoch_miss / UCP_MLP;
+  ucp_last_miss = miss;
+  ucp_last_latency = total_miss_latency;
+
+  // The hit counters are halved every epoch, they hold this many epochs worth of hits
+  ucp_hit_weight = ucp_hit_weight / 2 + 1;
+
+  // Alone, the core gets the whole LLC and its DRAM reads do not wait on other cores, the waiting overlaps like the misses do.
+  // Only epochs that lie entirely in the region of interest of the core are summed up
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    double alone = ucp_cycles(i, NUM_WAY) - ucp_epoch_interference[i] / UCP_MLP;
+    ucp_epoch_alone_cycle[i] = max(alone, max(ucp_epoch_instr[i] / RETIRE_WIDTH, 1.0));
+
+    bool roi = warmup_complete[i] && (current_core_cycle[i] - ucp_epoch_cycle[i] >= ooo_cpu[i].begin_sim_cycle);
+    if (roi && !simulation_complete[i] && ucp_epoch_instr[i])
+    {
+      ucp_alone_instr[i] += ucp_epoch_instr[i];
+      ucp_alone_cycle[i] += ucp_epoch_alone_cycle[i];
+    }
+  }
+}
+
+double CACHE::ucp_extra_misses(uint32_t core, uint32_t ways)
+{
+  // LLC misses the core would have had in the last epoch with the given ways on top of those it had: the ATD hits
+  // between its current allocation and the given one, scaled from the 32 sampled sets to the LLC
+  uint32_t current = partitions[core];
+  double hits = 0;
+  for (uint32_t p = min(ways, current); p < max(ways, current); p++)
+    hits += ucp_hits(core, p);
+  double extra_miss = hits * (NUM_SET / 32) / ucp_hit_weight;
+  if (ways > current)
+    extra_miss = -extra_miss;
+  return extra_miss;
+}
+
+double CACHE::ucp_cycles(uint32_t core, uint32_t ways)
+{
+  // Cycles the core would have taken in the last epoch with the given ways, every extra miss costs the miss penalty
+  double cycles = ucp_epoch_cycle[core] + ucp_extra_misses(core, ways) * ucp_miss_penalty;
+  return max(cycles, max(ucp_epoch_instr[core] / RETIRE_WIDTH, 1.0));
+}
+
+void CACHE::ucp_bandwidth_partition(const vector<uint32_t> &allocations)
+{
+  // The DRAM reads every core will issue per cycle with its new ways: the reads of the last epoch plus the misses
+  // the ATD expects from the change of allocation. Shares proportional to this rate to the power 2/3 maximize
+  // the weighted speedup of bandwidth-bound cores (Liu et al., HPCA 2010)
+  double share[NUM_CPUS], total = 0;
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    double reads = max(ucp_epoch_reads[i] + ucp_extra_misses(i, allocations[i]), 1.0);
+    share[i] = pow(reads / max(ucp_epoch_cycle[i], 1.0), 2.0 / 3);
+    total += share[i];
+  }
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    share[i] /= total;
+
+  uncore.DRAM.new_service_epoch(share);
+}
+
+double CACHE::ucp_utility(uint32_t core, uint32_t ways)
+{
+  // Value of the given ways to the core under the partitioning objective, relative to running alone
+  double slowdown = ucp_cycles(core, ways) / ucp_epoch_alone_cycle[core];
+  if (knob_ucp_objective == UCP_OBJ_WEIGHTED_SPEEDUP)
+    return 1 / slowdown;
+  return -slowdown;
+}
+
+double CACHE::ucp_alone_ipc(uint32_t core)
+{
+  // IPC the model expects of the core with the whole LLC to itself, over the epochs of its region of interest
+  if (ucp_alone_cycle[core] == 0)
+    return 0;
+  return ucp_alone_instr[core] / ucp_alone_cycle[core];
+}
+
+double CACHE::ucp_epoch_alone_ipc(uint32_t core)
+{
+  // Alone IPC of the core in the last epoch, 0 before the first one
+  if (ucp_epoch_alone_cycle[core] == 0)
+    return 0;
+  return ucp_epoch_instr[core] / ucp_epoch_alone_cycle[core];
+}
+
+double CACHE::ucp_epoch_slowdown(uint32_t core)
+{
+  // Slowdown of the core in the last epoch against running alone, 1 before the first one
+  if ((ucp_epoch_alone_cycle[core] == 0) || (ucp_epoch_instr[core] == 0))
+    return 1;
+  return ucp_epoch_cycle[core] / ucp_epoch_alone_cycle[core];
 }
 
 pair<float, uint32_t> CACHE::get_max_mu(uint32_t core, uint32_t alloc, uint32_t balance)
@@ -2087,9 +2582,42 @@ pair<float, uint32_t> CACHE::get_max_mu(uint32_t core, uint32_t alloc, uint32_t
 
 vector<uint32_t> CACHE::partition_algorithm()
 {
+  ucp_update_model();
+
+  // Page coloring hands out colors instead of ways, the ways stay with the owner of the color of each set
+  if (knob_llc_partition == LLC_PART_COLORS)
+  {
+    vector<uint32_t> colors = fine_partition_algorithm(LLC_COLORS);
+    recolor(colors);
+    ucp_bandwidth_partition(vector<uint32_t>(partitions.begin(), partitions.end()));
+    ucp_decay_counters();
+    return colors;
+  }
+
+  // Line partitioning hands out targets in eighths of a way, futility scaling holds every core near its target
+  if (knob_llc_partition == LLC_PART_LINES)
+  {
+    vector<uint32_t> units = fine_partition_algorithm(LLC_LINE_UNITS), ways(NUM_CPUS);
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      ways[i] = max((units[i] * NUM_WAY + LLC_LINE_UNITS / 2) / LLC_LINE_UNITS, 1u);
+    ucp_bandwidth_partition(ways);
+    ucp_decay_counters();
+    return retarget_lines(units);
+  }
+
   // We allocate atleast one way to each CPU
   int balance = NUM_WAY - NUM_CPUS;
   vector<uint32_t> allocations(NUM_CPUS, 1);
+  // High-priority cores first get the ways the model says they need to reach their IPC target
+  for (uint32_t application = 0; application < NUM_CPUS; application++)
+  {
+    while ((knob_ucp_min_ipc[application] > 0) && (balance > 0) &&
+           (ucp_epoch_instr[application] / ucp_cycles(application, allocations[application]) < knob_ucp_min_ipc[application]))
+    {
+      allocations[application]++;
+      balance--;
+    }
+  }
   vector<pair<float, uint32_t>> present_state(NUM_CPUS, {0, 0});
   while (balance != 0)
   {
@@ -2111,6 +2639,20 @@ vector<uint32_t> CACHE::partition_algorithm()
         max_mu = present_state[application].first;
       }
     }
+    // To minimize the maximum slowdown, the most slowed down core that still gains from more ways goes first
+    if (knob_ucp_objective == UCP_OBJ_MAX_SLOWDOWN)
+    {
+      double max_slowdown = 0;
+      for (uint32_t application = 0; application < NUM_CPUS; application++)
+      {
+        double slowdown = -ucp_utility(application, allocations[application]);
+        if ((present_state[application].first > 0) && (slowdown > max_slowdown))
+        {
+          winner = application;
+          max_slowdown = slowdown;
+        }
+      }
+    }
     allocations[winner] += present_state[winner].second;
     balance -= present_state[winner].second;
     // If no core requires additional ways to improve its performance, we break
@@ -2126,13 +2668,246 @@ vector<uint32_t> CACHE::partition_algorithm()
     if (i == 0)
       allocations[i] += left;
   }
+  // The DRAM bandwidth is shared out for the misses the new allocations leave to each core
+  ucp_bandwidth_partition(allocations);
+  ucp_decay_counters();
+  return allocations;
+}
+
+void CACHE::ucp_decay_counters()
+{
   // If the partitioning algorithm is called, we divide the number of counters by 2
   for (uint32_t i = 0; i < NUM_CPUS; i++)
   {
     for (uint32_t j = 0; j < NUM_WAY; j++)
     {
       hit_counts[i][j] /= 2;
+      pf_hit_counts[i][j] /= 2;
     }
+    pf_useless_atd[i] /= 2;
+    atd_access[i] /= 2;
   }
-  return allocations;
+}
+
+uint32_t CACHE::llc_owner(uint32_t set, uint32_t cpu)
+{
+  // With page coloring a set belongs to the core that owns its color, a request of another core to it
+  // (a page not yet moved after recoloring) uses the ways of the owner
+  if (color_owner.empty())
+    return cpu;
+  return color_owner[set >> LOG2_COLOR_SETS];
+}
+
+void CACHE::color_initialize()
+{
+  // Every core starts with an equal range of colors and all the ways of their sets
+  color_owner.resize(LLC_COLORS);
+  color_first.resize(NUM_CPUS);
+  color_count.resize(NUM_CPUS);
+  color_next.resize(NUM_CPUS, 0);
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    color_first[i] = i * (LLC_COLORS / NUM_CPUS);
+    color_count[i] = LLC_COLORS / NUM_CPUS;
+    partitions[i] = NUM_WAY;
+  }
+  color_count[NUM_CPUS - 1] += LLC_COLORS % NUM_CPUS;
+  for (uint32_t c = 0; c < LLC_COLORS; c++)
+    color_owner[c] = min(c / (LLC_COLORS / NUM_CPUS), (uint32_t)NUM_CPUS - 1);
+
+  for (uint32_t set = 0; set < NUM_SET; set++)
+  {
+    for (uint32_t way = 0; way < NUM_WAY; way++)
+    {
+      block[set][way].cpu = color_owner[set >> LOG2_COLOR_SETS];
+      block[set][way].lru = way;
+    }
+  }
+}
+
+uint64_t CACHE::color_page(uint32_t cpu, uint64_t ppage)
+{
+  // The physical page with the next color of the core, new pages go round robin over its colors
+  uint64_t color = color_first[cpu] + (color_next[cpu]++ % color_count[cpu]);
+  return (ppage & ~(uint64_t)(LLC_COLORS - 1)) | color;
+}
+
+double CACHE::ucp_fractional_hits(uint32_t core, double ways)
+{
+  // ATD hits with a fractional number of ways, interpolated between the LRU positions
+  double hits = 0;
+  for (uint32_t p = 0; (p < NUM_WAY) && (p < ways); p++)
+    hits += ucp_hits(core, p) * min(1.0, ways - p);
+  return hits;
+}
+
+vector<uint32_t> CACHE::fine_partition_algorithm(uint32_t units)
+{
+  // The ATD models every core alone in the whole LLC, u of the units (colors or eighths of a way) hold as many lines
+  // as NUM_WAY * u / units ways. They are handed out by the UCP lookahead on the same hit counters, one unit at a time
+  // instead of whole ways
+  vector<uint32_t> given(NUM_CPUS, 1);
+  uint32_t balance = units - NUM_CPUS;
+  while (balance > 0)
+  {
+    uint32_t winner = 0, winner_units = 0;
+    double max_mu = 0;
+    for (uint32_t application = 0; application < NUM_CPUS; application++)
+    {
+      double scale = (double)NUM_WAY / units,
+             base = ucp_fractional_hits(application, given[application] * scale);
+      for (uint32_t extra = 1; extra <= balance; extra++)
+      {
+        double mu = (ucp_fractional_hits(application, (given[application] + extra) * scale) - base) / extra;
+        if (mu > max_mu)
+        {
+          max_mu = mu;
+          winner = application;
+          winner_units = extra;
+        }
+      }
+    }
+    // If no core gains from more units, the rest is divided equally
+    if (winner_units == 0)
+      break;
+    given[winner] += winner_units;
+    balance -= winner_units;
+  }
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    given[i] += balance / NUM_CPUS + ((i == 0) ? balance % NUM_CPUS : 0);
+
+  return given;
+}
+
+void CACHE::recolor(const vector<uint32_t> &colors)
+{
+  // The cores get consecutive color ranges, a color that changes owner hands all the ways of its sets over
+  // with the lines in them. The pages of the old owner move lazily, at their next translation (va_to_pa),
+  // so the TLB entries that map to a color the core lost are dropped
+  uint32_t first = 0;
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    color_first[i] = first;
+    color_count[i] = colors[i];
+    for (uint32_t c = first; c < first + colors[i]; c++)
+    {
+      if (color_owner[c] == i)
+        continue;
+      color_owner[c] = i;
+      recolored++;
+      for (uint32_t set = c << LOG2_COLOR_SETS; set < ((c + 1) << LOG2_COLOR_SETS); set++)
+        for (uint32_t way = 0; way < NUM_WAY; way++)
+          block[set][way].cpu = i;
+    }
+    first += colors[i];
+  }
+
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    CACHE *tlb[3] = {&ooo_cpu[i].ITLB, &ooo_cpu[i].DTLB, &ooo_cpu[i].STLB};
+    for (uint32_t t = 0; t < 3; t++)
+      for (uint32_t set = 0; set < tlb[t]->NUM_SET; set++)
+        for (uint32_t way = 0; way < tlb[t]->NUM_WAY; way++)
+          if (tlb[t]->block[set][way].valid && (color_owner[tlb[t]->block[set][way].data & (LLC_COLORS - 1)] != i))
+            tlb[t]->block[set][way].valid = 0;
+  }
+}
+
+void CACHE::futility_initialize()
+{
+  // Every core starts with an equal share of the lines and all the ways, the lines belong to whoever fills them
+  target_lines.assign(NUM_CPUS, (uint64_t)NUM_SET * NUM_WAY / NUM_CPUS);
+  owned_lines.assign(NUM_CPUS, 0);
+  futility_scale.assign(NUM_CPUS, 1.0);
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    partitions[i] = NUM_WAY;
+}
+
+vector<uint32_t> CACHE::retarget_lines(const vector<uint32_t> &units)
+{
+  // u units are u / LLC_LINE_UNITS of the lines of the LLC. The lines every core holds are recounted here,
+  // the fills and invalidations keep the count up to date in between
+  vector<uint32_t> lines(NUM_CPUS);
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    target_lines[i] = (uint64_t)units[i] * NUM_SET * NUM_WAY / LLC_LINE_UNITS;
+    lines[i] = target_lines[i];
+    owned_lines[i] = 0;
+  }
+  for (uint32_t set = 0; set < NUM_SET; set++)
+    for (uint32_t way = 0; way < NUM_WAY; way++)
+      if (block[set][way].valid)
+        owned_lines[block[set][way].cpu]++;
+
+  return lines;
+}
+
+void CACHE::futility_update()
+{
+  // A core above its target gets its lines more futile and loses them faster, one below it keeps them longer
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    if (owned_lines[i] > target_lines[i])
+      futility_scale[i] = min(futility_scale[i] * LLC_FS_STEP, LLC_FS_MAX);
+    else if (owned_lines[i] < target_lines[i])
+      futility_scale[i] = max(futility_scale[i] / LLC_FS_STEP, 1 / LLC_FS_MAX);
+  }
+}
+
+uint32_t CACHE::llc_futility_victim(uint32_t cpu, uint32_t set)
+{
+  /*
+    Futility scaling (Wang and Chen, MICRO 2014): the futility of a line is its rank in the LRU stack of its core
+    within the set counted from the MRU end, relative to the core's target share of the set, times the scaling
+    factor of the core. The LRU line of a core is its most futile one, with the rank of the number of lines the core
+    holds in the set, so the victim is the LRU line of the core for which that futility is largest, ties go to the
+    core with the most lines in the set. Only the choice is made here, a fill can still be refused when the lower
+    level WQ is full
+  */
+  uint32_t way = 0;
+  while ((way < NUM_WAY) && block[set][way].valid)
+    way++;
+
+  if (way == NUM_WAY)
+  {
+    vector<uint32_t> lines(NUM_CPUS, 0), lru_way(NUM_CPUS, NUM_WAY);
+    for (uint32_t w = 0; w < NUM_WAY; w++)
+    {
+      uint32_t c = block[set][w].cpu;
+      lines[c]++;
+      if ((lru_way[c] == NUM_WAY) || (block[set][w].lru > block[set][lru_way[c]].lru))
+        lru_way[c] = w;
+    }
+
+    uint32_t victim = NUM_CPUS;
+    double max_futility = 0;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+      if (lines[i] == 0)
+        continue;
+      double share = max((double)target_lines[i] / NUM_SET, 1.0),
+             futility = lines[i] / share * futility_scale[i];
+      if ((victim == NUM_CPUS) || (futility > max_futility) || ((futility == max_futility) && (lines[i] > lines[victim])))
+      {
+        victim = i;
+        max_futility = futility;
+      }
+    }
+    way = lru_way[victim];
+  }
+
+  return way;
+}
+
+void CACHE::futility_fill(uint32_t cpu, uint32_t set, uint32_t way)
+{
+  // The victim is handed to the filling core below the bottom of its LRU stack, so that the replacement update
+  // that follows moves it to the MRU position of that core
+  if (block[set][way].valid)
+    owned_lines[block[set][way].cpu]--;
+  owned_lines[cpu]++;
+  block[set][way].cpu = cpu;
+  block[set][way].lru = NUM_WAY;
+  if (++futility_fills % LLC_FS_INTERVAL == 0)
+    futility_update();
 }
\ No newline at end of file
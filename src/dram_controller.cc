@@ -1,4 +1,5 @@
 #include "dram_controller.h"
+#include "profiler.h"
 
 // initialized in main.cc
 uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME,
@@ -25,6 +26,7 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t chan
                 bank_request[op_channel][op_rank][op_bank].open_row = op_row;
             else
                 bank_request[op_channel][op_rank][op_bank].open_row = UINT32_MAX;
+            shadow_row[op_cpu][op_channel][op_rank][op_bank] = bank_request[op_channel][op_rank][op_bank].open_row;
 
             // this bank is ready for another DRAM request
             bank_request[op_channel][op_rank][op_bank].request_index = -1;
@@ -68,6 +70,8 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t chan
 
 void MEMORY_CONTROLLER::operate()
 {
+    PROFILE(PROF_DRAM);
+
     for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
         //if ((write_mode[i] == 0) && (WQ[i].occupancy >= DRAM_WRITE_HIGH_WM)) {
       if ((write_mode[i] == 0) && ((WQ[i].occupancy >= DRAM_WRITE_HIGH_WM) || ((RQ[i].occupancy == 0) && (WQ[i].occupancy > 0)))) { // use idle cycles to perform writes
@@ -120,8 +124,68 @@ void MEMORY_CONTROLLER::operate()
     }
 }
 
+// start a new epoch of the core-aware read schedulers, called by the LLC partitioner with the bandwidth shares it decided
+void MEMORY_CONTROLLER::new_service_epoch(const double *share)
+{
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        attained_service[i] = DRAM_SERVICE_DECAY * attained_service[i] + epoch_service[i];
+        epoch_service[i] = 0;
+
+        if (knob_dram_sched == DRAM_SCHED_PARTITION)
+            bandwidth_share[i] = share[i];
+    }
+}
+
+// pick a read by starvation, then by the rank of its core, then row buffer hit, then age
+int MEMORY_CONTROLLER::rank_schedule(PACKET_QUEUE *queue, uint8_t &row_buffer_hit)
+{
+    double rank[NUM_CPUS];
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        rank[i] = (attained_service[i] + epoch_service[i]) / bandwidth_share[i];
+
+    int best = -1;
+    uint8_t best_starved = 0, best_hit = 0;
+    for (uint32_t i=0; i<queue->SIZE; i++) {
+        PACKET *entry = &queue->entry[i];
+        if (entry->scheduled || (entry->address == 0))
+            continue;
+
+        uint32_t channel = dram_get_channel(entry->address),
+                 rank_id = dram_get_rank(entry->address),
+                 bank = dram_get_bank(entry->address);
+        if (bank_request[channel][rank_id][bank].working)
+            continue;
+
+        uint8_t hit = (bank_request[channel][rank_id][bank].open_row == dram_get_row(entry->address)),
+                starved = (current_core_cycle[entry->cpu] > entry->event_cycle + DRAM_STARVATION_CYCLES);
+
+        bool better;
+        if (best < 0)
+            better = true;
+        else if (starved != best_starved)
+            better = starved;
+        else if (!starved && (rank[entry->cpu] != rank[queue->entry[best].cpu]))
+            better = rank[entry->cpu] < rank[queue->entry[best].cpu];
+        else if (hit != best_hit)
+            better = hit;
+        else
+            better = entry->event_cycle < queue->entry[best].event_cycle;
+
+        if (better) {
+            best = i;
+            best_starved = starved;
+            best_hit = hit;
+        }
+    }
+
+    row_buffer_hit = best_hit;
+    return best;
+}
+
 void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
 {
+    PROFILE(PROF_DRAM_SCHEDULE);
+
     uint64_t read_addr;
     uint32_t read_channel, read_rank, read_bank, read_row;
     uint8_t  row_buffer_hit = 0;
@@ -129,8 +193,13 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
     int oldest_index = -1;
     uint64_t oldest_cycle = UINT64_MAX;
 
+    // the core-aware schedulers pick the read themselves
+    bool frfcfs = queue->is_WQ || (knob_dram_sched == DRAM_SCHED_FRFCFS);
+    if (!frfcfs)
+        oldest_index = rank_schedule(queue, row_buffer_hit);
+
     // first, search for the oldest open row hit
-    for (uint32_t i=0; i<queue->SIZE; i++) {
+    for (uint32_t i=0; frfcfs && (i<queue->SIZE); i++) {
 
         // already scheduled
         if (queue->entry[i].scheduled) 
@@ -182,7 +251,7 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
         }	  
     }
 
-    if (oldest_index == -1) { // no matching open_row (row buffer miss)
+    if (frfcfs && (oldest_index == -1)) { // no matching open_row (row buffer miss)
 
         oldest_cycle = UINT64_MAX;
         for (uint32_t i=0; i<queue->SIZE; i++) {
@@ -251,6 +320,25 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
             scheduled_reads[op_channel]++;
         }
 
+        // a read pays a row conflict another core caused, and every waiting read of another core to this bank loses the bank for LATENCY
+        if (!queue->is_WQ) {
+            if (!row_buffer_hit && (shadow_row[op_cpu][op_channel][op_rank][op_bank] == op_row)) {
+                queue->entry[oldest_index].dram_interference += tRP + tRCD;
+                core_row_conflicts[op_cpu]++;
+            }
+            epoch_service[op_cpu] += LATENCY;
+
+            for (uint32_t i=0; i<queue->SIZE; i++) {
+                PACKET *waiting = &queue->entry[i];
+                if (waiting->address && !waiting->scheduled && (waiting->cpu != op_cpu)
+                    && (dram_get_rank(waiting->address) == op_rank) && (dram_get_bank(waiting->address) == op_bank))
+                    waiting->dram_interference += LATENCY;
+            }
+        }
+
+        // the writes of a core open rows just like its reads would when it runs alone
+        shadow_row[op_cpu][op_channel][op_rank][op_bank] = op_row;
+
         // update open row
         bank_request[op_channel][op_rank][op_bank].open_row = op_row;
 
@@ -301,6 +389,8 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
         // check if data bus is available
         if (dbus_cycle_available[op_channel] <= current_core_cycle[op_cpu]) {
 
+            dbus_last_cpu[op_channel] = op_cpu;
+
             if (queue->is_WQ) {
                 // update data bus cycle time
                 dbus_cycle_available[op_channel] = current_core_cycle[op_cpu] + DRAM_DBUS_RETURN_TIME;
@@ -330,8 +420,14 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                 cout << " row: " << op_row << " column: " << op_column;
                 cout << " current_cycle: " << current_core_cycle[op_cpu] << " event_cycle: " << queue->entry[request_index].event_cycle << endl; });
 
+                core_reads[op_cpu]++;
+                core_interference[op_cpu] += queue->entry[request_index].dram_interference;
+
                 // send data back to the core cache hierarchy
-                upper_level_dcache[op_cpu]->return_data(&queue->entry[request_index]);
+                if (queue->entry[request_index].is_metadata)
+                    upper_level_dcache[op_cpu]->return_metadata(&queue->entry[request_index]);
+                else
+                    upper_level_dcache[op_cpu]->return_data(&queue->entry[request_index]);
 
                 if (bank_request[op_channel][op_rank][op_bank].row_buffer_hit)
                     queue->ROW_BUFFER_HIT++;
@@ -396,6 +492,10 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
             }
 #endif
 
+            // a read waiting for a transfer of another core
+            if (!queue->is_WQ && (dbus_last_cpu[op_channel] != op_cpu))
+                queue->entry[request_index].dram_interference += (dbus_cycle_available[op_channel] - current_core_cycle[op_cpu]);
+
             dbus_cycle_congested[op_channel] += (dbus_cycle_available[op_channel] - current_core_cycle[op_cpu]);
             bank_request[op_channel][op_rank][op_bank].cycle_available = dbus_cycle_available[op_channel];
             dbus_congested[NUM_TYPES][NUM_TYPES]++;
@@ -416,7 +516,9 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
 int MEMORY_CONTROLLER::add_rq(PACKET *packet)
 {
     // simply return read requests with dummy response before the warmup
-    if (all_warmup_complete < NUM_CPUS) {
+    if ((all_warmup_complete < NUM_CPUS) || functional_warming) {
+        if (packet->is_metadata)
+            upper_level_dcache[packet->cpu]->return_metadata(packet);
         if (packet->instruction) 
             upper_level_icache[packet->cpu]->return_data(packet);
         if (packet->is_data)
@@ -434,6 +536,8 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
         //if (packet->fill_level < fill_level) {
 
             packet->data = WQ[channel].entry[wq_index].data;
+            if (packet->is_metadata)
+                upper_level_dcache[packet->cpu]->return_metadata(packet);
             if (packet->instruction) 
                 upper_level_icache[packet->cpu]->return_data(packet);
             if (packet->is_data) 
@@ -464,6 +568,7 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
         if (RQ[channel].entry[index].address == 0) {
             
             RQ[channel].entry[index] = *packet;
+            RQ[channel].entry[index].dram_interference = 0;
             RQ[channel].occupancy++;
 
 #ifdef DEBUG_PRINT
@@ -492,7 +597,7 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
 int MEMORY_CONTROLLER::add_wq(PACKET *packet)
 {
     // simply drop write requests before the warmup
-    if (all_warmup_complete < NUM_CPUS)
+    if ((all_warmup_complete < NUM_CPUS) || functional_warming)
         return -1;
 
     // check for duplicates in the write queue
@@ -601,7 +706,8 @@ int MEMORY_CONTROLLER::check_dram_queue(PACKET_QUEUE *queue, PACKET *packet)
 {
     // search write queue
     for (uint32_t index=0; index<queue->SIZE; index++) {
-        if (queue->entry[index].address == packet->address) {
+        // metadata and cache lines may share a physical address, but their reads return to different places
+        if ((queue->entry[index].address == packet->address) && (queue->entry[index].is_metadata == packet->is_metadata)) {
             
             DP ( if (warmup_complete[packet->cpu]) {
             cout << "[" << queue->NAME << "] " << __func__ << " same entry instr_id: " << packet->instr_id << " prior_id: " << queue->entry[index].instr_id;
@@ -0,0 +1,147 @@
+#include "interval_stats.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+INTERVAL_STATS interval_stats;
+
+uint64_t total_miss(CACHE *cache, uint32_t cpu)
+{
+    uint64_t miss = 0;
+    for (uint32_t i=0; i<NUM_TYPES; i++)
+        miss += cache->sim_miss[cpu][i];
+
+    return miss;
+}
+
+uint64_t row_buffer_hits()
+{
+    uint64_t hit = 0;
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        hit += uncore.DRAM.RQ[i].ROW_BUFFER_HIT + uncore.DRAM.WQ[i].ROW_BUFFER_HIT;
+
+    return hit;
+}
+
+uint64_t row_buffer_misses()
+{
+    uint64_t miss = 0;
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        miss += uncore.DRAM.RQ[i].ROW_BUFFER_MISS + uncore.DRAM.WQ[i].ROW_BUFFER_MISS;
+
+    return miss;
+}
+
+void INTERVAL_STATS::initialize(uint64_t period, uint32_t size, const char *filename)
+{
+    PERIOD = period;
+    next_cycle = period;
+    SIZE = size;
+    occupancy = 0;
+    ring = new INTERVAL_SAMPLE[SIZE];
+    snapshot();
+
+    out = fopen(filename, "w");
+    if (out == NULL) {
+        cerr << "[INTERVAL_STATS] " << __func__ << " cannot open " << filename << endl;
+        assert(0);
+    }
+
+    fprintf(out, "cycle");
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        fprintf(out, ",cpu%u_ipc,cpu%u_l1d_mpki,cpu%u_l2c_mpki,cpu%u_llc_mpki,cpu%u_ways", i, i, i, i, i);
+        fprintf(out, ",cpu%u_dram_interference,cpu%u_alone_ipc,cpu%u_slowdown", i, i, i);
+        for (uint32_t j=0; j<LLC_WAY; j++)
+            fprintf(out, ",cpu%u_hits%u", i, j);
+    }
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        fprintf(out, ",ch%u_rq_occupancy,ch%u_wq_occupancy", i, i);
+    fprintf(out, ",row_buffer_hit_rate\n");
+}
+
+void INTERVAL_STATS::sample()
+{
+    next_cycle += PERIOD;
+
+    INTERVAL_SAMPLE *s = &ring[occupancy];
+    s->cycle = current_core_cycle[0];
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        uint64_t l1d_miss = total_miss(&ooo_cpu[i].L1D, i),
+                 l2c_miss = total_miss(&ooo_cpu[i].L2C, i),
+                 llc_miss = total_miss(&uncore.LLC, i);
+
+        s->instr[i] = ooo_cpu[i].num_retired - last_instr[i];
+        s->cycles[i] = current_core_cycle[i] - last_cycle[i];
+        s->l1d_miss[i] = l1d_miss - last_l1d_miss[i];
+        s->l2c_miss[i] = l2c_miss - last_l2c_miss[i];
+        s->llc_miss[i] = llc_miss - last_llc_miss[i];
+        s->dram_reads[i] = uncore.DRAM.core_reads[i] - last_dram_reads[i];
+        s->dram_interference[i] = uncore.DRAM.core_interference[i] - last_dram_interference[i];
+        s->alone_ipc[i] = uncore.LLC.ucp_epoch_alone_ipc(i);
+        s->slowdown[i] = uncore.LLC.ucp_epoch_slowdown(i);
+
+        s->ways[i] = uncore.LLC.partitions[i];
+        for (uint32_t j=0; j<LLC_WAY; j++)
+            s->hit_counts[i][j] = uncore.LLC.hit_counts[i][j];
+    }
+
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        s->rq_occupancy[i] = uncore.DRAM.RQ[i].occupancy;
+        s->wq_occupancy[i] = uncore.DRAM.WQ[i].occupancy;
+    }
+    s->row_buffer_hit = row_buffer_hits() - last_row_buffer_hit;
+    s->row_buffer_miss = row_buffer_misses() - last_row_buffer_miss;
+
+    snapshot();
+    occupancy++;
+    if (occupancy == SIZE)
+        flush();
+}
+
+// the next deltas start from the counters as they are now, also called when the warmup resets them
+void INTERVAL_STATS::snapshot()
+{
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        last_instr[i] = ooo_cpu[i].num_retired;
+        last_cycle[i] = current_core_cycle[i];
+        last_l1d_miss[i] = total_miss(&ooo_cpu[i].L1D, i);
+        last_l2c_miss[i] = total_miss(&ooo_cpu[i].L2C, i);
+        last_llc_miss[i] = total_miss(&uncore.LLC, i);
+        last_dram_reads[i] = uncore.DRAM.core_reads[i];
+        last_dram_interference[i] = uncore.DRAM.core_interference[i];
+    }
+    last_row_buffer_hit = row_buffer_hits();
+    last_row_buffer_miss = row_buffer_misses();
+}
+
+void INTERVAL_STATS::flush()
+{
+    for (uint32_t n=0; n<occupancy; n++) {
+        INTERVAL_SAMPLE *s = &ring[n];
+
+        fprintf(out, "%lu", s->cycle);
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            double kilo_instr = s->instr[i] ? s->instr[i] / 1000.0 : 1;
+            fprintf(out, ",%.4f,%.3f,%.3f,%.3f,%u", s->cycles[i] ? (1.0 * s->instr[i]) / s->cycles[i] : 0,
+                    s->l1d_miss[i] / kilo_instr, s->l2c_miss[i] / kilo_instr, s->llc_miss[i] / kilo_instr, s->ways[i]);
+            // average cycles a DRAM read of the core waited on other cores
+            fprintf(out, ",%.2f,%.4f,%.4f", s->dram_reads[i] ? (1.0 * s->dram_interference[i]) / s->dram_reads[i] : 0,
+                    s->alone_ipc[i], s->slowdown[i]);
+            for (uint32_t j=0; j<LLC_WAY; j++)
+                fprintf(out, ",%lu", s->hit_counts[i][j]);
+        }
+        for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+            fprintf(out, ",%u,%u", s->rq_occupancy[i], s->wq_occupancy[i]);
+
+        uint64_t row_buffer_access = s->row_buffer_hit + s->row_buffer_miss;
+        fprintf(out, ",%.4f\n", row_buffer_access ? (1.0 * s->row_buffer_hit) / row_buffer_access : 0);
+    }
+    occupancy = 0;
+}
+
+void INTERVAL_STATS::finish()
+{
+    flush();
+    fclose(out);
+    out = NULL;
+}
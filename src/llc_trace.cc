@@ -0,0 +1,72 @@
+#include "llc_trace.h"
+#include "champsim.h"
+
+LLC_TRACE llc_trace;
+
+void LLC_TRACE::initialize(const char *filename, uint32_t num_cpus, uint32_t sets_log2, uint32_t ways)
+{
+    assert(sets_log2 <= 16);
+
+    SIZE = 65536;
+    occupancy = 0;
+    log2_sets = sets_log2;
+    last_cycle = 0;
+    records = 0;
+    buffer = new LLC_TRACE_RECORD[SIZE];
+
+    out = fopen(filename, "wb");
+    if (out == NULL) {
+        cerr << "[LLC_TRACE] " << __func__ << " cannot open " << filename << endl;
+        assert(0);
+    }
+
+    LLC_TRACE_HEADER header;
+    header.magic = LLC_TRACE_MAGIC;
+    header.version = LLC_TRACE_VERSION;
+    header.num_cpus = num_cpus;
+    header.log2_sets = log2_sets;
+    header.ways = ways;
+    header.reserved = 0;
+    fwrite(&header, sizeof(header), 1, out);
+}
+
+void LLC_TRACE::record(uint32_t cpu, uint64_t address, uint32_t type, uint8_t event, uint8_t hit, uint8_t warmup, uint64_t cycle)
+{
+    LLC_TRACE_RECORD *r = &buffer[occupancy];
+
+    r->tag = address >> log2_sets;
+    r->set = address & ((1 << log2_sets) - 1);
+    r->cpu = cpu;
+    r->info = (type & LLC_TRACE_TYPE_MASK) | (hit ? LLC_TRACE_HIT : 0) | ((event & LLC_TRACE_EVENT_MASK) << LLC_TRACE_EVENT_SHIFT) | (warmup ? LLC_TRACE_WARMUP : 0);
+
+    // the cores run in lockstep, a request of a core that is a cycle behind records a zero delta
+    uint64_t delta = (cycle > last_cycle) ? (cycle - last_cycle) : 0;
+    r->cycle = (delta > UINT32_MAX) ? UINT32_MAX : delta;
+    if (cycle > last_cycle)
+        last_cycle = cycle;
+
+    records++;
+    occupancy++;
+    if (occupancy == SIZE)
+        flush();
+}
+
+void LLC_TRACE::flush()
+{
+    if (occupancy && (fwrite(buffer, sizeof(LLC_TRACE_RECORD), occupancy, out) != occupancy)) {
+        cerr << "[LLC_TRACE] " << __func__ << " write failed" << endl;
+        assert(0);
+    }
+    occupancy = 0;
+}
+
+void LLC_TRACE::finish()
+{
+    flush();
+    fclose(out);
+    out = NULL;
+    delete[] buffer;
+    buffer = NULL;
+
+    cout << "LLC trace: " << records << " records" << endl;
+}
@@ -3,7 +3,11 @@
 #include <getopt.h>
 #include "ooo_cpu.h"
 #include "uncore.h"
+#include "interval_stats.h"
+#include "llc_trace.h"
+#include "profiler.h"
 #include <fstream>
+#include <cmath>
 
 uint8_t warmup_complete[NUM_CPUS],
     simulation_complete[NUM_CPUS],
@@ -11,7 +15,17 @@ uint8_t warmup_complete[NUM_CPUS],
     all_simulation_complete = 0,
     MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS,
     knob_cloudsuite = 0,
-    knob_low_bandwidth = 0;
+    knob_low_bandwidth = 0,
+    functional_warming = 0,
+    knob_ucp_prefetch = UCP_PF_IGNORE,
+    knob_ucp_pf_ways = 0,
+    knob_ucp_objective = UCP_OBJ_HITS,
+    knob_pf_dedup = 0,
+    knob_dram_sched = DRAM_SCHED_FRFCFS,
+    knob_llc_partition = LLC_PART_WAYS,
+    knob_llc_inclusion = LLC_NON_INCLUSIVE;
+
+double knob_ucp_min_ipc[NUM_CPUS]; // IPC targets of the high-priority cores, 0 for the others
 
 uint64_t warmup_instructions = 1000000,
          simulation_instructions = 10000000,
@@ -19,11 +33,32 @@ uint64_t warmup_instructions = 1000000,
 
 time_t start_time;
 
+// SMARTS-style periodic sampling (disabled when sample_period is 0)
+// every sample_period instructions: functional warming, then sample_warm detailed warming instructions,
+// then a sample_unit instruction measurement unit. stops once the IPC confidence interval is within sample_error
+#define SAMPLE_Z 3.0 // 99.7% confidence
+#define SAMPLE_MIN_UNITS 30
+#define SAMPLE_WARMING 0
+#define SAMPLE_DETAILED_WARMUP 1
+#define SAMPLE_MEASURE 2
+
+uint64_t sample_period = 0,
+         sample_unit = 10000,
+         sample_warm = 2000;
+double sample_error = 2.0; // target half-width in percent of the mean IPC
+
+uint8_t sample_phase = SAMPLE_DETAILED_WARMUP;
+uint64_t sample_units = 0,
+         sample_phase_instr[NUM_CPUS],
+         sample_phase_cycle[NUM_CPUS];
+double sample_ipc_sum[NUM_CPUS], sample_ipc_sqsum[NUM_CPUS];
+
 // PAGE TABLE
-uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0;
+uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0, MIGRATION_LATENCY = 0;
 queue<uint64_t> page_queue;
 map<uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
-uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
+uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS],
+    page_migrations[NUM_CPUS]; // pages moved to a color of their core after recoloring
 
 void record_roi_stats(uint32_t cpu, CACHE *cache)
 {
@@ -35,6 +70,34 @@ void record_roi_stats(uint32_t cpu, CACHE *cache)
     }
 }
 
+void print_pf_histogram(CACHE *cache, const char *title, uint64_t *useful, uint64_t *useless, uint32_t size, uint32_t step)
+{
+    cout << cache->NAME << " PREFETCH  " << title << " USEFUL/USELESS:";
+    for (uint32_t i = 0; i < size; i++)
+        if (useful[i] || useless[i])
+            cout << "  " << i * step << ((i == size - 1) ? "+" : "") << ": " << useful[i] << "/" << useless[i];
+    cout << endl;
+}
+
+void print_pf_distance(CACHE *cache, const char *title, uint64_t *distance)
+{
+    // bucket i holds distances below 16 << i cycles, the last one everything above
+    cout << cache->NAME << " PREFETCH  " << title << ":";
+    for (uint32_t i = 0; i < PF_DISTANCE_BUCKETS - 1; i++)
+        cout << "  <" << (16ULL << i) << ": " << distance[i];
+    cout << "  >=" << (16ULL << (PF_DISTANCE_BUCKETS - 2)) << ": " << distance[PF_DISTANCE_BUCKETS - 1] << endl;
+}
+
+void print_pf_timeliness(CACHE *cache)
+{
+    cout << cache->NAME << " PREFETCH  LATE: " << setw(10) << cache->pf_late << "  FILL: " << setw(10) << cache->pf_fill << endl;
+    print_pf_distance(cache, "FILL TO USE CYCLES", cache->pf_use_distance);
+    print_pf_distance(cache, "LATE BY CYCLES IN FLIGHT", cache->pf_late_distance);
+
+    print_pf_histogram(cache, "DEPTH", cache->pf_useful_depth, cache->pf_useless_depth, PF_DEPTH_BUCKETS, 1);
+    print_pf_histogram(cache, "CONFIDENCE", cache->pf_useful_conf, cache->pf_useless_conf, PF_CONF_BUCKETS, 10);
+}
+
 void print_roi_stats(uint32_t cpu, CACHE *cache)
 {
     uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
@@ -65,6 +128,23 @@ void print_roi_stats(uint32_t cpu, CACHE *cache)
     cout << " PREFETCH  REQUESTED: " << setw(10) << cache->pf_requested << "  ISSUED: " << setw(10) << cache->pf_issued;
     cout << "  USEFUL: " << setw(10) << cache->pf_useful << "  USELESS: " << setw(10) << cache->pf_useless << endl;
 
+    if (cache->pf_filtered)
+        cout << cache->NAME << " PREFETCH  FILTERED: " << setw(10) << cache->pf_filtered << endl;
+
+    if (cache->pf_fill || cache->pf_late)
+        print_pf_timeliness(cache);
+
+    if ((cache->cache_type == IS_LLC) && (knob_llc_inclusion == LLC_INCLUSIVE))
+    {
+        cout << cache->NAME;
+        cout << " BACK-INVALIDATED: " << setw(10) << cache->back_invalidations[cpu] << "  DIRTY: " << setw(10) << cache->back_invalidation_writebacks[cpu] << endl;
+    }
+    if ((cache->cache_type == IS_LLC) && (knob_llc_inclusion == LLC_EXCLUSIVE))
+    {
+        cout << cache->NAME;
+        cout << " CLEAN VICTIMS: " << setw(10) << cache->clean_victims[cpu] << "  MOVED UP: " << setw(10) << cache->moved_up[cpu] << endl;
+    }
+
     cout << cache->NAME;
     cout << " AVERAGE MISS LATENCY: " << (1.0 * (cache->total_miss_latency)) / TOTAL_MISS << " cycles" << endl;
     // cout << " AVERAGE MISS LATENCY: " << (cache->total_miss_latency)/TOTAL_MISS << " cycles " << cache->total_miss_latency << "/" << TOTAL_MISS<< endl;
@@ -135,6 +215,19 @@ void print_dram_stats()
         cout << endl;
     }
 
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        cout << " CPU " << i << " READS: " << setw(10) << uncore.DRAM.core_reads[i] << "  ROW_CONFLICTS_BY_OTHERS: " << setw(10) << uncore.DRAM.core_row_conflicts[i];
+        cout << "  AVG_INTERFERENCE_CYCLE: ";
+        if (uncore.DRAM.core_reads[i])
+            cout << (uncore.DRAM.core_interference[i] / uncore.DRAM.core_reads[i]);
+        else
+            cout << "-";
+        if (knob_dram_sched == DRAM_SCHED_PARTITION)
+            cout << "  BANDWIDTH_SHARE: " << uncore.DRAM.bandwidth_share[i];
+        cout << endl;
+    }
+
     uint64_t total_congested_cycle = 0;
     for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
         total_congested_cycle += uncore.DRAM.dbus_cycle_congested[i];
@@ -166,6 +259,14 @@ void reset_cache_stats(uint32_t cpu, CACHE *cache)
     cache->pf_useful = 0;
     cache->pf_useless = 0;
     cache->pf_fill = 0;
+    cache->pf_late = 0;
+    cache->pf_filtered = 0;
+    cache->reset_pf_timeliness();
+
+    cache->back_invalidations[cpu] = 0;
+    cache->back_invalidation_writebacks[cpu] = 0;
+    cache->clean_victims[cpu] = 0;
+    cache->moved_up[cpu] = 0;
 
     cache->RQ.ACCESS = 0;
     cache->RQ.MERGED = 0;
@@ -178,6 +279,35 @@ void reset_cache_stats(uint32_t cpu, CACHE *cache)
     cache->WQ.FULL = 0;
 }
 
+// switch between the zero-latency warmup model and the detailed timing model
+void set_timing_mode(uint8_t detailed)
+{
+    // reset core latency
+    // note: since re-ordering he function calls in the main simulation loop, it's no longer necessary to add
+    //       extra latency for scheduling and execution, unless you want these steps to take longer than 1 cycle.
+    SCHEDULING_LATENCY = 0;
+    EXEC_LATENCY = 0;
+    DECODE_LATENCY = detailed ? 2 : 0;
+    PAGE_TABLE_LATENCY = detailed ? 100 : 0;
+    SWAP_LATENCY = detailed ? 100000 : 0;
+    MIGRATION_LATENCY = detailed ? 1000 : 0; // copying a page to its new color
+
+    // set actual cache latency
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        ooo_cpu[i].ITLB.LATENCY = detailed ? ITLB_LATENCY : 0;
+        ooo_cpu[i].DTLB.LATENCY = detailed ? DTLB_LATENCY : 0;
+        ooo_cpu[i].STLB.LATENCY = detailed ? STLB_LATENCY : 0;
+        ooo_cpu[i].L1I.LATENCY = detailed ? L1I_LATENCY : 0;
+        ooo_cpu[i].L1D.LATENCY = detailed ? L1D_LATENCY : 0;
+        ooo_cpu[i].L2C.LATENCY = detailed ? L2C_LATENCY : 0;
+    }
+    uncore.LLC.LATENCY = detailed ? LLC_LATENCY : 0;
+
+    // the DRAM controller answers with dummy responses while warming
+    functional_warming = !detailed;
+}
+
 void finish_warmup()
 {
     uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
@@ -186,14 +316,7 @@ void finish_warmup()
     elapsed_minute -= elapsed_hour * 60;
     elapsed_second -= (elapsed_hour * 3600 + elapsed_minute * 60);
 
-    // reset core latency
-    // note: since re-ordering he function calls in the main simulation loop, it's no longer necessary to add
-    //       extra latency for scheduling and execution, unless you want these steps to take longer than 1 cycle.
-    SCHEDULING_LATENCY = 0;
-    EXEC_LATENCY = 0;
-    DECODE_LATENCY = 2;
-    PAGE_TABLE_LATENCY = 100;
-    SWAP_LATENCY = 100000;
+    set_timing_mode(1);
 
     cout << endl;
     for (uint32_t i = 0; i < NUM_CPUS; i++)
@@ -229,18 +352,344 @@ void finish_warmup()
         uncore.DRAM.WQ[i].ROW_BUFFER_HIT = 0;
         uncore.DRAM.WQ[i].ROW_BUFFER_MISS = 0;
     }
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        uncore.DRAM.core_reads[i] = 0;
+        uncore.DRAM.core_interference[i] = 0;
+        uncore.DRAM.core_row_conflicts[i] = 0;
 
-    // set actual cache latency
+        // the UCP epochs take differences of these counters
+        uncore.LLC.ucp_last_reads[i] = 0;
+        uncore.LLC.ucp_last_interference[i] = 0;
+    }
+
+    // so do the interval statistics
+    if (interval_stats.PERIOD)
+        interval_stats.snapshot();
+}
+
+void begin_sample_phase(uint8_t phase)
+{
+    sample_phase = phase;
     for (uint32_t i = 0; i < NUM_CPUS; i++)
     {
-        ooo_cpu[i].ITLB.LATENCY = ITLB_LATENCY;
-        ooo_cpu[i].DTLB.LATENCY = DTLB_LATENCY;
-        ooo_cpu[i].STLB.LATENCY = STLB_LATENCY;
-        ooo_cpu[i].L1I.LATENCY = L1I_LATENCY;
-        ooo_cpu[i].L1D.LATENCY = L1D_LATENCY;
-        ooo_cpu[i].L2C.LATENCY = L2C_LATENCY;
+        sample_phase_instr[i] = ooo_cpu[i].num_retired;
+        sample_phase_cycle[i] = current_core_cycle[i];
     }
-    uncore.LLC.LATENCY = LLC_LATENCY;
+}
+
+// relative half-width of the IPC confidence interval of one core, in percent
+double sample_ci(uint32_t cpu)
+{
+    if (sample_units < 2)
+        return 100.0;
+
+    double mean = sample_ipc_sum[cpu] / sample_units,
+           var = (sample_ipc_sqsum[cpu] - sample_units * mean * mean) / (sample_units - 1);
+    if (mean <= 0) // a core that retired nothing in its units has not converged
+        return 100.0;
+    if (var < 0)
+        var = 0;
+
+    return 100.0 * SAMPLE_Z * sqrt(var / sample_units) / mean;
+}
+
+// advance the sampling state machine, returns 1 when every core's IPC estimate has converged
+uint8_t update_sampling()
+{
+    uint64_t phase_length = sample_unit;
+    if (sample_phase == SAMPLE_WARMING)
+        phase_length = sample_period - sample_warm - sample_unit;
+    else if (sample_phase == SAMPLE_DETAILED_WARMUP)
+        phase_length = sample_warm;
+
+    // phases end once the slowest core has retired enough instructions
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        if (ooo_cpu[i].num_retired - sample_phase_instr[i] < phase_length)
+            return 0;
+
+    if (sample_phase == SAMPLE_WARMING)
+    {
+        set_timing_mode(1);
+        begin_sample_phase(SAMPLE_DETAILED_WARMUP);
+    }
+    else if (sample_phase == SAMPLE_DETAILED_WARMUP)
+        begin_sample_phase(SAMPLE_MEASURE);
+    else
+    {
+        for (uint32_t i = 0; i < NUM_CPUS; i++)
+        {
+            double ipc = (1.0 * (ooo_cpu[i].num_retired - sample_phase_instr[i])) / (current_core_cycle[i] - sample_phase_cycle[i]);
+            sample_ipc_sum[i] += ipc;
+            sample_ipc_sqsum[i] += ipc * ipc;
+        }
+        sample_units++;
+
+        if (sample_units >= SAMPLE_MIN_UNITS)
+        {
+            uint8_t converged = 1;
+            for (uint32_t i = 0; i < NUM_CPUS; i++)
+                if (sample_ci(i) > sample_error)
+                    converged = 0;
+            if (converged)
+                return 1;
+        }
+
+        set_timing_mode(0);
+        begin_sample_phase(SAMPLE_WARMING);
+    }
+
+    return 0;
+}
+
+void print_sample_stats()
+{
+    cout << endl
+         << "Sampling Statistics" << endl;
+    cout << "Units: " << sample_units << " unit: " << sample_unit << " detailed warmup: " << sample_warm << " period: " << sample_period << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        cout << "CPU " << i << " sampled IPC: ";
+        if (sample_units)
+            cout << sample_ipc_sum[i] / sample_units << " +/- " << sample_ci(i) << "% (99.7% confidence)" << endl;
+        else
+            cout << "-" << endl;
+    }
+}
+
+// the region of interest of a sampled run includes the zero-latency functional warming, its cumulative IPC
+// cannot be compared with the sampled IPC and is not reported
+void print_roi_ipc(uint64_t instr, uint64_t cycle)
+{
+    if (sample_period)
+        cout << "-";
+    else
+        cout << ((float)instr / cycle);
+}
+
+// slowdown of every core against the alone IPC the UCP model estimated for it, 0 while there is no estimate
+// and in a sampled run, where neither IPC is measured in detailed mode only
+double fairness_slowdown(uint32_t cpu)
+{
+    if (sample_period)
+        return 0;
+
+    double ipc = ooo_cpu[cpu].finish_sim_cycle ? (1.0 * ooo_cpu[cpu].finish_sim_instr) / ooo_cpu[cpu].finish_sim_cycle : 0,
+           alone = uncore.LLC.ucp_alone_ipc(cpu);
+
+    return ((ipc > 0) && (alone > 0)) ? alone / ipc : 0;
+}
+
+// the speedups only cover the cores with an estimate, the ones without are left out and counted
+void print_fairness_stats()
+{
+    double weighted_speedup = 0, inverse_speedup = 0, max_slowdown = 0;
+    uint32_t estimated = 0;
+
+    cout << endl
+         << "Fairness Statistics" << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        double slowdown = fairness_slowdown(i);
+        cout << "CPU " << i << " estimated alone IPC: ";
+        if (slowdown == 0)
+        {
+            cout << "- slowdown: -" << endl;
+            continue;
+        }
+        cout << uncore.LLC.ucp_alone_ipc(i) << " slowdown: " << slowdown << endl;
+
+        weighted_speedup += 1 / slowdown;
+        inverse_speedup += slowdown;
+        max_slowdown = max(max_slowdown, slowdown);
+        estimated++;
+    }
+
+    if (estimated == 0)
+    {
+        cout << "WEIGHTED SPEEDUP: -  HARMONIC SPEEDUP: -  MAX SLOWDOWN: -" << endl;
+        return;
+    }
+    cout << "WEIGHTED SPEEDUP: " << weighted_speedup << "  HARMONIC SPEEDUP: " << estimated / inverse_speedup << "  MAX SLOWDOWN: " << max_slowdown;
+    if (estimated < NUM_CPUS)
+        cout << "  (incomplete, " << estimated << " of " << NUM_CPUS << " cores have an alone IPC estimate)";
+    cout << endl;
+}
+
+void json_array(ofstream &out, const uint64_t *counter, uint32_t size)
+{
+    out << "[";
+    for (uint32_t i = 0; i < size; i++)
+        out << (i ? ", " : "") << counter[i];
+    out << "]";
+}
+
+// quotes, backslashes and control characters of a trace path are escaped
+void json_string(ofstream &out, const char *str)
+{
+    out << "\"";
+    for (const char *c = str; *c; c++)
+    {
+        if ((*c == '"') || (*c == '\\'))
+            out << '\\' << *c;
+        else if ((unsigned char)*c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            out << escaped;
+        }
+        else
+            out << *c;
+    }
+    out << "\"";
+}
+
+// JSON has no NaN or infinity, an undefined ratio is written as null
+void json_number(ofstream &out, double value)
+{
+    if (isfinite(value))
+        out << value;
+    else
+        out << "null";
+}
+
+void json_pf_timeliness(ofstream &out, CACHE *cache)
+{
+    out << ", \"pf_late\": " << cache->pf_late;
+    out << ", \"pf_use_distance\": ";
+    json_array(out, cache->pf_use_distance, PF_DISTANCE_BUCKETS);
+    out << ", \"pf_late_distance\": ";
+    json_array(out, cache->pf_late_distance, PF_DISTANCE_BUCKETS);
+    out << ", \"pf_useful_depth\": ";
+    json_array(out, cache->pf_useful_depth, PF_DEPTH_BUCKETS);
+    out << ", \"pf_useless_depth\": ";
+    json_array(out, cache->pf_useless_depth, PF_DEPTH_BUCKETS);
+    out << ", \"pf_useful_conf\": ";
+    json_array(out, cache->pf_useful_conf, PF_CONF_BUCKETS);
+    out << ", \"pf_useless_conf\": ";
+    json_array(out, cache->pf_useless_conf, PF_CONF_BUCKETS);
+}
+
+// per-cpu counters of one cache, prefetch counters are only meaningful for private caches
+void json_cache_stats(ofstream &out, uint32_t cpu, CACHE *cache, uint8_t with_prefetch)
+{
+    out << "\"" << cache->NAME << "\": {";
+    out << "\"sim_access\": ";
+    json_array(out, cache->sim_access[cpu], NUM_TYPES);
+    out << ", \"sim_hit\": ";
+    json_array(out, cache->sim_hit[cpu], NUM_TYPES);
+    out << ", \"sim_miss\": ";
+    json_array(out, cache->sim_miss[cpu], NUM_TYPES);
+    out << ", \"roi_access\": ";
+    json_array(out, cache->roi_access[cpu], NUM_TYPES);
+    out << ", \"roi_hit\": ";
+    json_array(out, cache->roi_hit[cpu], NUM_TYPES);
+    out << ", \"roi_miss\": ";
+    json_array(out, cache->roi_miss[cpu], NUM_TYPES);
+    if ((cache->cache_type == IS_LLC) && knob_llc_inclusion)
+    {
+        out << ", \"back_invalidations\": " << cache->back_invalidations[cpu] << ", \"back_invalidation_writebacks\": " << cache->back_invalidation_writebacks[cpu];
+        out << ", \"clean_victims\": " << cache->clean_victims[cpu] << ", \"moved_up\": " << cache->moved_up[cpu];
+    }
+    if (with_prefetch)
+    {
+        out << ", \"pf_requested\": " << cache->pf_requested << ", \"pf_issued\": " << cache->pf_issued;
+        out << ", \"pf_useful\": " << cache->pf_useful << ", \"pf_useless\": " << cache->pf_useless << ", \"pf_fill\": " << cache->pf_fill;
+        out << ", \"pf_filtered\": " << cache->pf_filtered;
+        out << ", \"total_miss_latency\": " << cache->total_miss_latency;
+        json_pf_timeliness(out, cache);
+    }
+    out << "}";
+}
+
+// dump every counter as one JSON document, type arrays are indexed LOAD, RFO, PREFETCH, WRITEBACK
+void write_stats_json(const char *filename)
+{
+    ofstream out(filename);
+    if (!out.good())
+    {
+        cerr << "cannot open stats file " << filename << endl;
+        assert(0);
+    }
+
+    out << "{\n\"num_cpus\": " << NUM_CPUS << ", \"llc_sets\": " << LLC_SET << ", \"llc_ways\": " << LLC_WAY;
+    out << ", \"warmup_instructions\": " << warmup_instructions << ", \"simulation_instructions\": " << simulation_instructions;
+    out << ", \"roi_includes_functional_warming\": " << (sample_period ? "true" : "false") << ",\n";
+
+    out << "\"cpus\": [\n";
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+        uint64_t sim_instr = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr,
+                 sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
+
+        out << "  {\"cpu\": " << i << ", \"trace\": ";
+        json_string(out, ooo_cpu[i].trace_string);
+        out << ", \"roi_instructions\": " << ooo_cpu[i].finish_sim_instr << ", \"roi_cycles\": " << ooo_cpu[i].finish_sim_cycle;
+        out << ", \"roi_ipc\": ";
+        json_number(out, sample_period ? NAN : ooo_cpu[i].finish_sim_cycle ? (1.0 * ooo_cpu[i].finish_sim_instr) / ooo_cpu[i].finish_sim_cycle : 0);
+        out << ", \"sim_instructions\": " << sim_instr << ", \"sim_cycles\": " << sim_cycle;
+        out << ", \"sim_ipc\": ";
+        json_number(out, sample_period ? NAN : sim_cycle ? (1.0 * sim_instr) / sim_cycle : 0);
+        if (fairness_slowdown(i) > 0)
+        {
+            out << ", \"alone_ipc_estimate\": ";
+            json_number(out, uncore.LLC.ucp_alone_ipc(i));
+            out << ", \"slowdown\": ";
+            json_number(out, fairness_slowdown(i));
+        }
+        else
+            out << ", \"alone_ipc_estimate\": null, \"slowdown\": null";
+        out << ", \"num_branch\": " << ooo_cpu[i].num_branch << ", \"branch_mispredictions\": " << ooo_cpu[i].branch_mispredictions;
+        out << ", \"branch_types\": ";
+        json_array(out, ooo_cpu[i].total_branch_types, 8);
+        out << ", \"major_fault\": " << major_fault[i] << ", \"minor_fault\": " << minor_fault[i];
+        if (knob_llc_partition == LLC_PART_COLORS)
+            out << ", \"page_migrations\": " << page_migrations[i];
+        out << ",\n   ";
+        json_cache_stats(out, i, &ooo_cpu[i].L1D, 1);
+        out << ",\n   ";
+        json_cache_stats(out, i, &ooo_cpu[i].L1I, 1);
+        out << ",\n   ";
+        json_cache_stats(out, i, &ooo_cpu[i].L2C, 1);
+        out << ",\n   ";
+        json_cache_stats(out, i, &uncore.LLC, 0);
+        if (sample_period)
+        {
+            // there is no IPC without a sample and no error without two
+            out << ",\n   \"sampled_ipc\": ";
+            json_number(out, sample_units ? sample_ipc_sum[i] / sample_units : NAN);
+            out << ", \"sampled_ipc_error\": ";
+            json_number(out, (sample_units > 1) ? sample_ci(i) : NAN);
+        }
+        out << "}" << (i + 1 < NUM_CPUS ? "," : "") << "\n";
+    }
+    out << "],\n";
+
+    out << "\"LLC\": {\"pf_requested\": " << uncore.LLC.pf_requested << ", \"pf_issued\": " << uncore.LLC.pf_issued;
+    out << ", \"pf_useful\": " << uncore.LLC.pf_useful << ", \"pf_useless\": " << uncore.LLC.pf_useless << ", \"pf_fill\": " << uncore.LLC.pf_fill;
+    out << ", \"pf_filtered\": " << uncore.LLC.pf_filtered;
+    out << ", \"total_miss_latency\": " << uncore.LLC.total_miss_latency;
+    json_pf_timeliness(out, &uncore.LLC);
+    out << "},\n";
+
+    out << "\"DRAM\": {\"dbus_congested\": " << uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES] << ", \"channels\": [";
+    for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+    {
+        out << (i ? ", " : "") << "{\"rq_row_buffer_hit\": " << uncore.DRAM.RQ[i].ROW_BUFFER_HIT << ", \"rq_row_buffer_miss\": " << uncore.DRAM.RQ[i].ROW_BUFFER_MISS;
+        out << ", \"wq_row_buffer_hit\": " << uncore.DRAM.WQ[i].ROW_BUFFER_HIT << ", \"wq_row_buffer_miss\": " << uncore.DRAM.WQ[i].ROW_BUFFER_MISS;
+        out << ", \"wq_full\": " << uncore.DRAM.WQ[i].FULL << ", \"dbus_cycle_congested\": " << uncore.DRAM.dbus_cycle_congested[i] << "}";
+    }
+    out << "]},\n";
+
+    out << "\"partitions\": [";
+    for (uint32_t i = 0; i < uncore.LLC.partition_history.size(); i++)
+    {
+        out << (i ? "," : "") << "\n  {\"cycle\": " << uncore.LLC.partition_history[i].first << ((knob_llc_partition == LLC_PART_COLORS) ? ", \"colors\": [" : (knob_llc_partition == LLC_PART_LINES) ? ", \"lines\": [" : ", \"ways\": [");
+        for (uint32_t j = 0; j < uncore.LLC.partition_history[i].second.size(); j++)
+            out << (j ? ", " : "") << uncore.LLC.partition_history[i].second[j];
+        out << "]}";
+    }
+    out << "\n]\n}\n";
 }
 
 void print_deadlock(uint32_t i)
@@ -329,7 +778,7 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
         assert(0);
 #endif
 
-    uint8_t swap = 0;
+    uint8_t swap = 0, migrated = 0;
     uint64_t high_bit_mask = rotr64(cpu, lg2(NUM_CPUS)),
              unique_va = va | high_bit_mask;
     // uint64_t vpage = unique_va >> LOG2_PAGE_SIZE,
@@ -432,6 +881,10 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
                 fragmented = 1;
             }
 
+            // with page coloring every page is drawn at random and takes the next color of the core
+            if (knob_llc_partition == LLC_PART_COLORS)
+                random_ppage = uncore.LLC.color_page(cpu, champsim_rand.draw_rand());
+
             // encoding cpu number
             // this allows ChampSim to run homogeneous multi-programmed workloads without VA => PA aliasing
             // (e.g., cpu0: astar  cpu1: astar  cpu2: astar  cpu3: astar...)
@@ -450,6 +903,8 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
 
                     // try one more time
                     random_ppage = champsim_rand.draw_rand();
+                    if (knob_llc_partition == LLC_PART_COLORS)
+                        random_ppage = uncore.LLC.color_page(cpu, random_ppage);
 
                     // encoding cpu number
                     // random_ppage &= (~((NUM_CPUS-1)<<(32-LOG2_PAGE_SIZE)));
@@ -482,6 +937,30 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
         else
             minor_fault[cpu]++;
     }
+    else if ((knob_llc_partition == LLC_PART_COLORS) && (uncore.LLC.color_owner[pr->second & (LLC_COLORS - 1)] != cpu))
+    {
+        // the color of the page went to another core with the last recoloring, the page moves to a color of this core
+        uint64_t old_ppage = pr->second, new_ppage;
+        do
+            new_ppage = uncore.LLC.color_page(cpu, champsim_rand.draw_rand());
+        while (inverse_table.find(new_ppage) != inverse_table.end());
+
+        pr->second = new_ppage;
+        inverse_table.erase(old_ppage);
+        inverse_table.insert(make_pair(new_ppage, vpage));
+
+        for (uint32_t i = 0; i < BLOCK_SIZE; i++)
+        {
+            uint64_t cl_addr = (old_ppage << 6) | i;
+            ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
+            ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
+            ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
+            uncore.LLC.invalidate_entry(cl_addr);
+        }
+
+        migrated = 1;
+        page_migrations[cpu]++;
+    }
     else
     {
         // printf("Found  vpage: %lx  random_ppage: %lx\n", vpage, pr->second);
@@ -507,6 +986,8 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
         // if it's data, pay these penalties
         if (swap)
             stall_cycle[cpu] = current_core_cycle[cpu] + SWAP_LATENCY;
+        else if (migrated)
+            stall_cycle[cpu] = current_core_cycle[cpu] + PAGE_TABLE_LATENCY + MIGRATION_LATENCY;
         else
             stall_cycle[cpu] = current_core_cycle[cpu] + PAGE_TABLE_LATENCY;
     }
@@ -541,6 +1022,11 @@ int main(int argc, char **argv)
 
     // initialize knobs
     uint8_t show_heartbeat = 1;
+    char *stats_json = NULL;
+    uint64_t interval_cycles = 0;
+    uint32_t interval_buffer = 4096;
+    const char *interval_file = "interval_stats.csv";
+    char *llc_trace_file = NULL;
 
     uint32_t seed_number = 0;
 
@@ -556,6 +1042,23 @@ int main(int argc, char **argv)
                 {"cloudsuite", no_argument, 0, 'c'},
                 {"low_bandwidth", no_argument, 0, 'b'},
                 {"traces", no_argument, 0, 't'},
+                {"sample_period", required_argument, 0, 'p'},
+                {"sample_unit", required_argument, 0, 'u'},
+                {"sample_warmup", required_argument, 0, 'd'},
+                {"sample_error", required_argument, 0, 'e'},
+                {"stats_json", required_argument, 0, 'j'},
+                {"interval_cycles", required_argument, 0, 'n'},
+                {"interval_buffer", required_argument, 0, 'r'},
+                {"interval_file", required_argument, 0, 'f'},
+                {"ucp_prefetch", required_argument, 0, 'a'},
+                {"ucp_pf_ways", required_argument, 0, 'g'},
+                {"pf_dedup", required_argument, 0, 'x'},
+                {"llc_trace", required_argument, 0, 'o'},
+                {"ucp_objective", required_argument, 0, 'y'},
+                {"ucp_min_ipc", required_argument, 0, 'q'},
+                {"dram_sched", required_argument, 0, 'm'},
+                {"llc_partition", required_argument, 0, 'k'},
+                {"llc_inclusion", required_argument, 0, 'l'},
                 {0, 0, 0, 0}};
 
         int option_index = 0;
@@ -589,6 +1092,67 @@ int main(int argc, char **argv)
         case 't':
             traces_encountered = 1;
             break;
+        case 'p':
+            sample_period = atol(optarg);
+            break;
+        case 'u':
+            sample_unit = atol(optarg);
+            break;
+        case 'd':
+            sample_warm = atol(optarg);
+            break;
+        case 'e':
+            sample_error = atof(optarg);
+            break;
+        case 'j':
+            stats_json = optarg;
+            break;
+        case 'n':
+            interval_cycles = atol(optarg);
+            break;
+        case 'r':
+            interval_buffer = atol(optarg);
+            break;
+        case 'f':
+            interval_file = optarg;
+            break;
+        case 'a':
+            knob_ucp_prefetch = atoi(optarg);
+            break;
+        case 'g':
+            knob_ucp_pf_ways = atoi(optarg);
+            break;
+        case 'x':
+            knob_pf_dedup = atoi(optarg);
+            break;
+        case 'o':
+            llc_trace_file = optarg;
+            break;
+        case 'y':
+            knob_ucp_objective = atoi(optarg);
+            break;
+        case 'q':
+        {
+            // <cpu>:<ipc>, repeated for every high-priority core
+            uint32_t target_cpu = atoi(optarg);
+            const char *target = strchr(optarg, ':');
+            if ((target == NULL) || (target_cpu >= NUM_CPUS))
+            {
+                cerr << "ucp_min_ipc expects <cpu>:<ipc> with cpu below " << NUM_CPUS << endl;
+                assert(0);
+            }
+            knob_ucp_min_ipc[target_cpu] = atof(target + 1);
+            break;
+        }
+        case 'm':
+            knob_dram_sched = atoi(optarg);
+            break;
+        case 'k':
+            knob_llc_partition = atoi(optarg);
+            break;
+        case 'l':
+            knob_llc_inclusion = atoi(optarg);
+            break;
         default:
             abort();
         }
@@ -604,6 +1168,85 @@ int main(int argc, char **argv)
     cout << "Number of CPUs: " << NUM_CPUS << endl;
     cout << "LLC sets: " << LLC_SET << endl;
     cout << "LLC ways: " << LLC_WAY << endl;
+    if (sample_period)
+    {
+        if (sample_period <= sample_unit + sample_warm)
+        {
+            cerr << "sample_period must be larger than sample_unit + sample_warmup" << endl;
+            assert(0);
+        }
+        cout << "Sampling: " << sample_unit << " instructions every " << sample_period << " (detailed warmup: " << sample_warm;
+        cout << " target error: " << sample_error << "%)" << endl;
+    }
+    if (interval_buffer == 0)
+    {
+        cerr << "interval_buffer must hold at least one sample" << endl;
+        assert(0);
+    }
+    if (stats_json)
+    {
+        // a stats file that cannot be written fails the run now, not after the whole simulation
+        ofstream out(stats_json);
+        if (!out.good())
+        {
+            cerr << "cannot open stats file " << stats_json << endl;
+            assert(0);
+        }
+    }
+
+    if (knob_ucp_prefetch > UCP_PF_CHARGE)
+    {
+        cerr << "ucp_prefetch must be between " << UCP_PF_IGNORE << " and " << UCP_PF_CHARGE << endl;
+        assert(0);
+    }
+    if (knob_ucp_objective > UCP_OBJ_MAX_SLOWDOWN)
+    {
+        cerr << "ucp_objective must be between " << UCP_OBJ_HITS << " and " << UCP_OBJ_MAX_SLOWDOWN << endl;
+        assert(0);
+    }
+    if (knob_ucp_objective)
+        cout << "UCP objective: " << +knob_ucp_objective << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        if (knob_ucp_min_ipc[i] > 0)
+            cout << "UCP IPC target of CPU " << i << ": " << knob_ucp_min_ipc[i] << endl;
+    if (knob_ucp_prefetch || knob_ucp_pf_ways)
+        cout << "UCP prefetch accounting: " << +knob_ucp_prefetch << " prefetch ways per core: " << +knob_ucp_pf_ways << endl;
+    if (knob_dram_sched > DRAM_SCHED_PARTITION)
+    {
+        cerr << "dram_sched must be between " << DRAM_SCHED_FRFCFS << " and " << DRAM_SCHED_PARTITION << endl;
+        assert(0);
+    }
+    if (knob_dram_sched)
+        cout << "DRAM read scheduler: " << +knob_dram_sched << endl;
+    if (knob_llc_partition > LLC_PART_LINES)
+    {
+        cerr << "llc_partition must be between " << LLC_PART_WAYS << " and " << LLC_PART_LINES << endl;
+        assert(0);
+    }
+    if (knob_llc_partition != LLC_PART_WAYS)
+    {
+        // the IPC model behind the other objectives and the IPC targets works in ways
+        bool ipc_targets = false;
+        for (uint32_t i = 0; i < NUM_CPUS; i++)
+            if (knob_ucp_min_ipc[i] > 0)
+                ipc_targets = true;
+        if ((knob_ucp_objective != UCP_OBJ_HITS) || ipc_targets)
+        {
+            cerr << "llc_partition " << +knob_llc_partition << " only supports ucp_objective 0 without ucp_min_ipc" << endl;
+            assert(0);
+        }
+        if (knob_llc_partition == LLC_PART_COLORS)
+            cout << "LLC partitioning: page coloring, " << LLC_COLORS << " colors" << endl;
+        else
+            cout << "LLC partitioning: futility scaling, targets in 1/" << LLC_LINE_UNITS / LLC_WAY << " ways" << endl;
+    }
+    if (knob_llc_inclusion > LLC_EXCLUSIVE)
+    {
+        cerr << "llc_inclusion must be between " << LLC_NON_INCLUSIVE << " and " << LLC_EXCLUSIVE << endl;
+        assert(0);
+    }
+    if (knob_llc_inclusion)
+        cout << "LLC inclusion: " << ((knob_llc_inclusion == LLC_INCLUSIVE) ? "inclusive" : "exclusive") << endl;
 
     if (knob_low_bandwidth)
         DRAM_MTPS = DRAM_IO_FREQ / 4;
@@ -729,6 +1372,7 @@ int main(int argc, char **argv)
     // TODO: can we initialize these variables from the class constructor?
     srand(seed_number);
     champsim_seed = seed_number;
+    allocated_pages = 0; // prefetchers may reserve physical pages while the cores are set up
     for (int i = 0; i < NUM_CPUS; i++)
     {
 
@@ -820,17 +1464,32 @@ int main(int argc, char **argv)
         previous_ppage = 0;
         num_adjacent_page = 0;
         num_cl[i] = 0;
-        allocated_pages = 0;
         num_page[i] = 0;
         minor_fault[i] = 0;
         major_fault[i] = 0;
     }
 
     uncore.LLC.llc_initialize_replacement();
+    if (uncore.LLC.pseudo_partition && (knob_llc_partition != LLC_PART_WAYS))
+    {
+        cerr << "the LLC replacement policy shares every way, it only supports llc_partition 0" << endl;
+        assert(0);
+    }
+    if (knob_llc_partition == LLC_PART_COLORS)
+        uncore.LLC.color_initialize();
+    if (knob_llc_partition == LLC_PART_LINES)
+        uncore.LLC.futility_initialize();
     uncore.LLC.llc_prefetcher_initialize();
 
+    if (interval_cycles)
+        interval_stats.initialize(interval_cycles, interval_buffer, interval_file);
+
+    if (llc_trace_file)
+        llc_trace.initialize(llc_trace_file, NUM_CPUS, lg2(LLC_SET), LLC_WAY);
+
     // simulation entry point
     start_time = time(NULL);
+    profile_begin();
     uint8_t run_simulation = 1;
     while (run_simulation)
     {
@@ -925,6 +1584,8 @@ int main(int argc, char **argv)
             { // this part is called only once when all cores are warmed up
                 all_warmup_complete++;
                 finish_warmup();
+                if (sample_period)
+                    begin_sample_phase(SAMPLE_DETAILED_WARMUP);
             }
 
             /*
@@ -944,7 +1605,8 @@ int main(int argc, char **argv)
                 ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
 
                 cout << "Finished CPU " << i << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
-                cout << " cumulative IPC: " << ((float)ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
+                cout << " cumulative IPC: ";
+                print_roi_ipc(ooo_cpu[i].finish_sim_instr, ooo_cpu[i].finish_sim_cycle);
                 cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
 
                 record_roi_stats(i, &ooo_cpu[i].L1D);
@@ -959,11 +1621,43 @@ int main(int argc, char **argv)
                 run_simulation = 0;
         }
 
+        // sampling stops early once the IPC confidence interval is tight enough
+        if (sample_period && (all_warmup_complete > NUM_CPUS) && run_simulation && update_sampling())
+        {
+            cout << "Sampling converged after " << sample_units << " units" << endl;
+            for (uint32_t i = 0; i < NUM_CPUS; i++)
+            {
+                if (simulation_complete[i])
+                    continue;
+
+                simulation_complete[i] = 1;
+                ooo_cpu[i].finish_sim_instr = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
+                ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
+
+                record_roi_stats(i, &ooo_cpu[i].L1D);
+                record_roi_stats(i, &ooo_cpu[i].L1I);
+                record_roi_stats(i, &ooo_cpu[i].L2C);
+                record_roi_stats(i, &uncore.LLC);
+
+                all_simulation_complete++;
+            }
+            run_simulation = 0;
+        }
+
         // TODO: should it be backward?
         uncore.DRAM.operate();
         uncore.LLC.operate();
+
+        if (interval_cycles && (current_core_cycle[0] >= interval_stats.next_cycle))
+            interval_stats.sample();
     }
 
+    if (interval_cycles)
+        interval_stats.finish();
+
+    if (llc_trace_file)
+        llc_trace.finish();
+
     uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
              elapsed_minute = elapsed_second / 60,
              elapsed_hour = elapsed_minute / 60;
@@ -979,7 +1673,8 @@ int main(int argc, char **argv)
         for (uint32_t i = 0; i < NUM_CPUS; i++)
         {
             cout << endl
-                 << "CPU " << i << " cumulative IPC: " << (float)(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle);
+                 << "CPU " << i << " cumulative IPC: ";
+            print_roi_ipc(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr, current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle);
             cout << " instructions: " << ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr << " cycles: " << current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle << endl;
 #ifndef CRC2_COMPILE
             print_sim_stats(i, &ooo_cpu[i].L1D);
@@ -996,10 +1691,13 @@ int main(int argc, char **argv)
 
     cout << endl
          << "Region of Interest Statistics" << endl;
+    if (sample_period)
+        cout << "Sampled run: cycles and cache statistics include functional warming, see the sampled IPC" << endl;
     for (uint32_t i = 0; i < NUM_CPUS; i++)
     {
         cout << endl
-             << "CPU " << i << " cumulative IPC: " << ((float)ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
+             << "CPU " << i << " cumulative IPC: ";
+        print_roi_ipc(ooo_cpu[i].finish_sim_instr, ooo_cpu[i].finish_sim_cycle);
         cout << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle << endl;
 #ifndef CRC2_COMPILE
         print_roi_stats(i, &ooo_cpu[i].L1D);
@@ -1007,7 +1705,12 @@ int main(int argc, char **argv)
         print_roi_stats(i, &ooo_cpu[i].L2C);
 #endif
         print_roi_stats(i, &uncore.LLC);
-        cout << "Major fault: " << major_fault[i] << " Minor fault: " << minor_fault[i] << endl;
+        cout << "Major fault: " << major_fault[i] << " Minor fault: " << minor_fault[i];
+        if (knob_llc_partition == LLC_PART_COLORS)
+            cout << " Page migrations: " << page_migrations[i] << " LLC colors: " << uncore.LLC.color_count[i];
+        if (knob_llc_partition == LLC_PART_LINES)
+            cout << " LLC lines: " << uncore.LLC.owned_lines[i] << " target: " << uncore.LLC.target_lines[i] << " futility scale: " << uncore.LLC.futility_scale[i];
+        cout << endl;
     }
 
     for (uint32_t i = 0; i < NUM_CPUS; i++)
@@ -1025,5 +1728,19 @@ int main(int argc, char **argv)
     print_branch_stats();
 #endif
 
+    if (sample_period)
+        print_sample_stats();
+
+    if ((NUM_CPUS > 1) && !sample_period)
+        print_fairness_stats();
+
+    if (stats_json)
+        write_stats_json(stats_json);
+
+    uint64_t total_retired = 0;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        total_retired += ooo_cpu[i].num_retired;
+    profile_end(total_retired);
+
     return 0;
 }
@@ -1,5 +1,6 @@
 #include "ooo_cpu.h"
 #include "set.h"
+#include "profiler.h"
 
 // out-of-order core
 O3_CPU ooo_cpu[NUM_CPUS];
@@ -12,6 +13,8 @@ void O3_CPU::initialize_core()
 
 void O3_CPU::read_from_trace()
 {
+    PROFILE(PROF_READ_FROM_TRACE);
+
     // actual processors do not work like this but for easier implementation,
     // we read instruction traces and virtually add them in the ROB
     // note that these traces are not yet translated and fetched
@@ -581,6 +584,8 @@ uint32_t O3_CPU::check_rob(uint64_t instr_id)
 
 void O3_CPU::fetch_instruction()
 {
+    PROFILE(PROF_FETCH);
+
     // TODO: can we model wrong path execusion?
     // probalby not
 
@@ -755,6 +760,8 @@ void O3_CPU::fetch_instruction()
 
 void O3_CPU::decode_and_dispatch()
 {
+    PROFILE(PROF_DECODE);
+
     // dispatch DECODE_WIDTH instructions that have decoded into the ROB
     uint32_t count_dispatches = 0;
     for (uint32_t i = 0; i < DECODE_BUFFER.SIZE; i++)
@@ -872,6 +879,8 @@ int O3_CPU::prefetch_code_line(uint64_t pf_v_addr)
 // III. Instruction is retired
 void O3_CPU::schedule_instruction()
 {
+    PROFILE(PROF_SCHEDULE);
+
     if ((ROB.head == ROB.tail) && ROB.occupancy == 0)
         return;
 
@@ -1048,6 +1057,8 @@ void O3_CPU::reg_RAW_dependency(uint32_t prior, uint32_t current, uint32_t sourc
 
 void O3_CPU::execute_instruction()
 {
+    PROFILE(PROF_EXECUTE);
+
     if ((ROB.head == ROB.tail) && ROB.occupancy == 0)
         return;
 
@@ -1137,6 +1148,8 @@ void O3_CPU::do_execution(uint32_t rob_index)
 
 void O3_CPU::schedule_memory_instruction()
 {
+    PROFILE(PROF_SCHEDULE_MEMORY);
+
     if ((ROB.head == ROB.tail) && ROB.occupancy == 0)
         return;
 
@@ -1189,6 +1202,8 @@ void O3_CPU::schedule_memory_instruction()
 
 void O3_CPU::execute_memory_instruction()
 {
+    PROFILE(PROF_EXECUTE_MEMORY);
+
     operate_lsq();
     operate_cache();
 }
@@ -1947,6 +1962,8 @@ void O3_CPU::operate_cache()
 
 void O3_CPU::update_rob()
 {
+    PROFILE(PROF_UPDATE_ROB);
+
     if (ITLB.PROCESSED.occupancy && (ITLB.PROCESSED.entry[ITLB.PROCESSED.head].event_cycle <= current_core_cycle[cpu]))
         complete_instr_fetch(&ITLB.PROCESSED, 1);
 
@@ -2372,6 +2389,8 @@ void O3_CPU::release_load_queue(uint32_t lq_index)
 
 void O3_CPU::retire_rob()
 {
+    PROFILE(PROF_RETIRE);
+
     for (uint32_t n = 0; n < RETIRE_WIDTH; n++)
     {
         if (ROB.entry[ROB.head].ip == 0)
@@ -0,0 +1,52 @@
+#include "profiler.h"
+#include <chrono>
+
+#ifdef PROFILE_STAGES
+uint64_t prof_cycles[NUM_PROF_STAGES], prof_calls[NUM_PROF_STAGES];
+
+const char *prof_name[NUM_PROF_STAGES] = {
+    "ITLB operate", "DTLB operate", "STLB operate", "L1I operate", "L1D operate", "L2C operate", "LLC operate",
+    "partition", "DRAM operate", "DRAM schedule",
+    "read_from_trace", "fetch_instruction", "decode_and_dispatch", "schedule_instruction", "execute_instruction",
+    "schedule_memory_instruction", "execute_memory_instruction", "update_rob", "retire_rob"
+};
+
+uint64_t prof_total_begin;
+std::chrono::steady_clock::time_point prof_wall_begin;
+#endif
+
+void profile_begin()
+{
+#ifdef PROFILE_STAGES
+    for (uint32_t i=0; i<NUM_PROF_STAGES; i++) {
+        prof_cycles[i] = 0;
+        prof_calls[i] = 0;
+    }
+    prof_wall_begin = std::chrono::steady_clock::now();
+    prof_total_begin = __rdtsc();
+#endif
+}
+
+// print host cycles per simulated instruction for each stage and the simulation speed
+void profile_end(uint64_t instructions)
+{
+#ifdef PROFILE_STAGES
+    uint64_t total = __rdtsc() - prof_total_begin;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - prof_wall_begin).count();
+
+    if (instructions == 0)
+        instructions = 1;
+
+    cout << endl << "Simulator Profile (host cycles per simulated instruction)" << endl;
+    cout << "Instructions: " << instructions << " host cycles: " << total << " time: " << seconds << " sec";
+    cout << " KIPS: " << (seconds > 0 ? instructions / seconds / 1000 : 0) << endl;
+
+    // print the pipeline stages first, the caches are operated from execute_memory_instruction
+    for (uint32_t n=0; n<NUM_PROF_STAGES; n++) {
+        uint32_t i = (n + PROF_READ_FROM_TRACE) % NUM_PROF_STAGES;
+        cout << setw(30) << prof_name[i] << ": " << setw(10) << (1.0 * prof_cycles[i]) / instructions;
+        cout << "  (" << setw(5) << (100.0 * prof_cycles[i]) / total << "%)  calls: " << prof_calls[i] << endl;
+    }
+    cout << setw(30) << "total" << ": " << setw(10) << (1.0 * total) / instructions << endl;
+#endif
+}